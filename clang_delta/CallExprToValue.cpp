@@ -55,7 +55,8 @@ private:
 
 bool CallExprToValueVisitor::VisitCallExpr(CallExpr *CE)
 {
-  if (ConsumerInstance->isInIncludedFile(CE))
+  if (ConsumerInstance->isInIncludedFile(CE) ||
+      !ConsumerInstance->isInRegion(CE))
     return true;
 
   ConsumerInstance->ValidInstanceNum++;
@@ -90,7 +91,7 @@ void CallExprToValue::Initialize(ASTContext &context)
 
 void CallExprToValue::HandleTranslationUnit(ASTContext &Ctx)
 {
-  CollectionVisitor->TraverseDecl(Ctx.getTranslationUnitDecl());
+  traverseRegion(CollectionVisitor, Ctx.getTranslationUnitDecl());
 
   if (QueryInstanceOnly)
     return;
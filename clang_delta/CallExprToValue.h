@@ -40,6 +40,10 @@ public:
 
   ~CallExprToValue(void);
 
+  virtual bool supportsRegion(void) {
+    return true;
+  }
+
 private:
   
   virtual void Initialize(clang::ASTContext &context);
@@ -15,6 +15,10 @@
 #include <string>
 #include <sstream>
 #include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <vector>
+#include <utility>
 
 #include "llvm/Support/raw_ostream.h"
 #include "TransformationManager.h"
@@ -22,6 +26,34 @@
 
 static TransformationManager *TransMgr;
 static int ErrorCode = -1;
+static bool StartupBenchmark = false;
+
+typedef std::chrono::steady_clock BenchmarkClock;
+static BenchmarkClock::time_point LastBenchmarkTime;
+static std::vector<std::pair<const char *, double> > BenchmarkTimings;
+
+// Record the time spent since the previous call (or since main).
+static void RecordBenchmarkTiming(const char *Phase)
+{
+  BenchmarkClock::time_point Now = BenchmarkClock::now();
+  std::chrono::duration<double, std::milli> Elapsed = Now - LastBenchmarkTime;
+  BenchmarkTimings.push_back(std::make_pair(Phase, Elapsed.count()));
+  LastBenchmarkTime = Now;
+}
+
+static void PrintBenchmarkTimings(double PreMainCPUTime)
+{
+  double Total = 0;
+  llvm::errs() << "Startup benchmark (ms):\n";
+  // Loading shared libraries and running static constructors
+  // happen before main, so we can only report their CPU time.
+  llvm::errs() << "  before main (cpu): " << PreMainCPUTime << "\n";
+  for (auto &Timing : BenchmarkTimings) {
+    llvm::errs() << "  " << Timing.first << ": " << Timing.second << "\n";
+    Total += Timing.second;
+  }
+  llvm::errs() << "  total after main: " << Total << "\n";
+}
 
 static void PrintVersion()
 {
@@ -69,8 +101,11 @@ static void PrintHelpMessage()
   llvm::outs() << "specify the ending instance of the transformation to ";
   llvm::outs() << "perform (when this option is given, clang_delta will ";
   llvm::outs() << "rewrite multiple instances [counter,to-counter] ";
-  llvm::outs() << "simultaneously. Note that currently only ";
-  llvm::outs() << "replace-function-def-with-decl supports this feature.)\n";
+  llvm::outs() << "simultaneously. Note that currently only a few ";
+  llvm::outs() << "transformations such as replace-function-def-with-decl ";
+  llvm::outs() << "support this feature. For expression-detector, all ";
+  llvm::outs() << "candidates in the range are instrumented, each tagged ";
+  llvm::outs() << "with its counter.)\n";
 
   llvm::outs() << "  --replacement=<string>: ";
   llvm::outs() << "instead of performing normal rewriting, the candidate ";
@@ -85,7 +120,9 @@ static void PrintHelpMessage()
 
   llvm::outs() << "  --check-reference=<value>: ";
   llvm::outs() << "insert code to check if the candidate designated by the ";
-  llvm::outs() << "counter equals to the reference value or not. Currently, ";
+  llvm::outs() << "counter equals to the reference value or not (together with ";
+  llvm::outs() << "--to-counter, print the counters of the matching candidates ";
+  llvm::outs() << "instead). Currently, ";
   llvm::outs() << "this option works only with transformation ";
   llvm::outs() << "expression-detector.\n";
 
@@ -93,6 +130,19 @@ static void PrintHelpMessage()
   llvm::outs() << "specify where to output the transformed source code ";
   llvm::outs() << "(default: stdout)\n";
 
+  llvm::outs() << "  --range=<startline>:<endline>: ";
+  llvm::outs() << "only consider transformation instances whose source ";
+  llvm::outs() << "range lies within the given lines (inclusive) of the ";
+  llvm::outs() << "main file. Currently, this option works only with ";
+  llvm::outs() << "callexpr-to-value, expression-detector, ";
+  llvm::outs() << "remove-unused-var, replace-function-def-with-decl, ";
+  llvm::outs() << "simplify-callexpr and simplify-if.\n";
+
+  llvm::outs() << "  --decl=<qualified name>: ";
+  llvm::outs() << "same as --range, but the region is given by the source ";
+  llvm::outs() << "range of the named declaration (definitions are ";
+  llvm::outs() << "preferred)\n";
+
   llvm::outs() << "  --std=<standard>: ";
   llvm::outs() << "specify C++ standard used (c++98, c++11, c++14, c++17, c++20) ";
   llvm::outs() << "\n";
@@ -105,6 +155,16 @@ static void PrintHelpMessage()
   llvm::outs() << "make only warning when a counter is out of bounds ";
   llvm::outs() << "(replace-function-def-with-decl and remove-unused-function are supported)";
   llvm::outs() << "\n";
+
+  llvm::outs() << "  --startup-benchmark: ";
+  llvm::outs() << "report the time spent in each phase of clang_delta, ";
+  llvm::outs() << "from startup to the output of the result, on stderr\n";
+
+  llvm::outs() << "  --emit-topforms: ";
+  llvm::outs() << "instead of transforming, print the byte ranges ";
+  llvm::outs() << "\"<begin> <end>\" of all top-level declarations and of ";
+  llvm::outs() << "the members of records and namespaces, one per line. ";
+  llvm::outs() << "Cannot be used with --transformation.\n";
 }
 
 static void DieOnBadCmdArg(const std::string &ArgStr)
@@ -183,6 +243,21 @@ static void HandleOneArgValue(const std::string &ArgValueStr, size_t SepPos)
   else if (!ArgName.compare("std")) {
     TransMgr->setCXXStandard(ArgValue);
   }
+  else if (!ArgName.compare("range")) {
+    unsigned StartLine, EndLine;
+    char Sep;
+    std::stringstream TmpSS(ArgValue);
+
+    if (!(TmpSS >> StartLine >> Sep >> EndLine) || (Sep != ':') ||
+        !TmpSS.eof() || (StartLine == 0) || (StartLine > EndLine)) {
+      Die("Invalid range[" + ArgValueStr + "]");
+    }
+
+    TransMgr->setRegion(StartLine, EndLine);
+  }
+  else if (!ArgName.compare("decl")) {
+    TransMgr->setRegionDecl(ArgValue);
+  }
   else {
     DieOnBadCmdArg("--" + ArgValueStr);
   }
@@ -212,6 +287,12 @@ static void HandleOneNoneValueArg(const std::string &ArgStr)
   else if (!ArgStr.compare("warn-on-counter-out-of-bounds")) {
     TransMgr->setWarnOnCounterOutOfBounds(true);
   }
+  else if (!ArgStr.compare("emit-topforms")) {
+    TransMgr->setEmitTopForms(true);
+  }
+  else if (!ArgStr.compare("startup-benchmark")) {
+    StartupBenchmark = true;
+  }
   else {
     DieOnBadCmdArg(ArgStr);
   }
@@ -242,10 +323,14 @@ static void HandleOneArg(const char *Arg)
 
 int main(int argc, char **argv)
 {
+  double PreMainCPUTime = 1000.0 * std::clock() / CLOCKS_PER_SEC;
+  LastBenchmarkTime = BenchmarkClock::now();
+
   TransMgr = TransformationManager::GetInstance();
   for (int i = 1; i < argc; i++) {
     HandleOneArg(argv[i]);
   }
+  RecordBenchmarkTiming("parse arguments");
 
   std::string ErrorMsg;
   if (!TransMgr->verify(ErrorMsg, ErrorCode))
@@ -253,11 +338,13 @@ int main(int argc, char **argv)
 
   if (!TransMgr->initializeCompilerInstance(ErrorMsg))
     Die(ErrorMsg);
+  RecordBenchmarkTiming("initialize compiler instance");
 
   if (!TransMgr->doTransformation(ErrorMsg, ErrorCode)) {
     // fail to do transformation
     Die(ErrorMsg);
   }
+  RecordBenchmarkTiming("parse and transform");
 
   if (TransMgr->getQueryInstanceFlag()) 
     TransMgr->outputNumTransformationInstances();
@@ -265,6 +352,10 @@ int main(int argc, char **argv)
     TransMgr->outputNumTransformationInstancesToStderr();
 
   TransformationManager::Finalize();
+  RecordBenchmarkTiming("finalize");
+
+  if (StartupBenchmark)
+    PrintBenchmarkTimings(PreMainCPUTime);
   return 0;
 }
 
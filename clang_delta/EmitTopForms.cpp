@@ -0,0 +1,116 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (c) 2012, 2013, 2014, 2019 The University of Utah
+// All rights reserved.
+//
+// This file is distributed under the University of Illinois Open Source
+// License.  See the file COPYING for details.
+//
+//===----------------------------------------------------------------------===//
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "EmitTopForms.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+
+using namespace clang;
+
+void EmitTopForms::HandleTranslationUnit(ASTContext &Ctx)
+{
+  handleDeclContext(Ctx.getTranslationUnitDecl());
+}
+
+void EmitTopForms::handleDeclContext(const DeclContext *Ctx)
+{
+  for (DeclContext::decl_iterator I = Ctx->decls_begin(),
+       E = Ctx->decls_end(); I != E; ++I) {
+    handleOneDecl(*I);
+  }
+}
+
+void EmitTopForms::handleOneDecl(const Decl *D)
+{
+  // Skip decls without a removable range of their own,
+  // e.g., "public:" or a stray ";"
+  if (D->isImplicit() || isa<AccessSpecDecl>(D) || isa<EmptyDecl>(D))
+    return;
+
+  if (isInIncludedFile(D))
+    return;
+
+  // getDeclFullSourceRange would extend the range of a namespace or
+  // a braced linkage spec to the next semicolon.
+  SourceRange Range;
+  bool HasSemicolon = false;
+  if (isBracedContext(D)) {
+    Range = D->getSourceRange();
+  }
+  else {
+    Range = RewriteHelper->getDeclFullSourceRange(D);
+    HasSemicolon = RewriteHelper->hasTrailingSemicolon(D);
+  }
+  if (Range.getBegin().isInvalid() || Range.getEnd().isInvalid())
+    return;
+
+  SourceLocation StartLoc = SrcManager->getExpansionLoc(Range.getBegin());
+  SourceLocation EndLoc = Range.getEnd();
+  if (EndLoc.isMacroID())
+    EndLoc = SrcManager->getExpansionRange(EndLoc).getEnd();
+  // Without a trailing semicolon, the range ends with the closing
+  // brace token rather than right after it.
+  if (!HasSemicolon)
+    EndLoc = Lexer::getLocForEndOfToken(EndLoc, 0, *SrcManager,
+                                        Context->getLangOpts());
+
+  FileID MainFileID = SrcManager->getMainFileID();
+  if (EndLoc.isInvalid() ||
+      SrcManager->getFileID(StartLoc) != MainFileID ||
+      SrcManager->getFileID(EndLoc) != MainFileID)
+    return;
+
+  unsigned Begin = SrcManager->getFileOffset(StartLoc);
+  unsigned End = SrcManager->getFileOffset(EndLoc);
+  if (Begin >= End)
+    return;
+
+  // Declarators of the same declaration, e.g., "int a, b;",
+  // share one range.
+  if (!TopForms.empty() && TopForms.back().first == Begin) {
+    if (End > TopForms.back().second)
+      TopForms.back().second = End;
+  }
+  else {
+    TopForms.push_back(std::make_pair(Begin, End));
+  }
+
+  if (isa<NamespaceDecl>(D) || isa<LinkageSpecDecl>(D))
+    handleDeclContext(cast<DeclContext>(D));
+  else if (const RecordDecl *RD = dyn_cast<RecordDecl>(D)) {
+    if (RD->isThisDeclarationADefinition())
+      handleDeclContext(RD);
+  }
+}
+
+bool EmitTopForms::isBracedContext(const Decl *D)
+{
+  if (isa<NamespaceDecl>(D))
+    return true;
+  if (const LinkageSpecDecl *LSD = dyn_cast<LinkageSpecDecl>(D))
+    return LSD->hasBraces();
+  return false;
+}
+
+void EmitTopForms::outputTopForms(llvm::raw_ostream &OutStream)
+{
+  for (RangeVector::iterator I = TopForms.begin(),
+       E = TopForms.end(); I != E; ++I) {
+    OutStream << (*I).first << " " << (*I).second << "\n";
+  }
+  OutStream.flush();
+}
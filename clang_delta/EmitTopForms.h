@@ -0,0 +1,66 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (c) 2012, 2013, 2014, 2019 The University of Utah
+// All rights reserved.
+//
+// This file is distributed under the University of Illinois Open Source
+// License.  See the file COPYING for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef EMIT_TOP_FORMS_H
+#define EMIT_TOP_FORMS_H
+
+#include <utility>
+#include "llvm/ADT/SmallVector.h"
+#include "Transformation.h"
+
+namespace clang {
+  class ASTContext;
+  class Decl;
+  class DeclContext;
+}
+
+// Not a real transformation: it backs --emit-topforms, which prints
+// the byte ranges [begin, end) of all top-level declarations of the
+// main file and of the members of records and namespaces, one
+// "begin end" pair per line.
+class EmitTopForms : public Transformation {
+
+public:
+
+  EmitTopForms(const char *TransName, const char *Desc)
+    : Transformation(TransName, Desc)
+  { }
+
+  ~EmitTopForms(void) { }
+
+  virtual bool skipCounter(void) {
+    return true;
+  }
+
+  void outputTopForms(llvm::raw_ostream &OutStream);
+
+private:
+
+  typedef llvm::SmallVector<std::pair<unsigned, unsigned>, 100> RangeVector;
+
+  virtual void HandleTranslationUnit(clang::ASTContext &Ctx);
+
+  void handleDeclContext(const clang::DeclContext *Ctx);
+
+  void handleOneDecl(const clang::Decl *D);
+
+  bool isBracedContext(const clang::Decl *D);
+
+  RangeVector TopForms;
+
+  // Unimplemented
+  EmitTopForms(void);
+
+  EmitTopForms(const EmitTopForms &);
+
+  void operator=(const EmitTopForms &);
+};
+
+#endif
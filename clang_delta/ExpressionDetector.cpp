@@ -32,7 +32,10 @@ static const char *DescriptionMsg =
 Currently, only expressions of type integer and floating point are \
 considered valid. The transformation also injects a static control \
 variable to ensure that the expression of interest will be printed \
-only once.\n";
+only once. When --to-counter is given, all candidates in the range \
+[counter, to-counter] are instrumented at once, each one tagged with \
+its instance number (cvise_value_N(...), or cvise_match_N if it equals \
+the --check-reference value).\n";
 
 // Some known issues:
 // (1) Because we don't have any array-bound analysis, this pass will
@@ -238,7 +241,8 @@ bool ExprDetectorCollectionVisitor::VisitFunctionDecl(FunctionDecl *FD)
   }
 
   if (ConsumerInstance->isInIncludedFile(FD) ||
-      !FD->isThisDeclarationADefinition())
+      !FD->isThisDeclarationADefinition() ||
+      ConsumerInstance->isOutsideRegion(FD))
     return true;
 
   ExprDetectorTempVarVisitor VarVisitor(ConsumerInstance);
@@ -255,7 +259,8 @@ bool ExprDetectorCollectionVisitor::VisitFunctionDecl(FunctionDecl *FD)
 
 bool ExprDetectorStmtVisitor::VisitExpr(Expr *E)
 {
-  if (ConsumerInstance->isInIncludedFile(E))
+  if (ConsumerInstance->isInIncludedFile(E) ||
+      !ConsumerInstance->isInRegion(E))
     return true;
 
   switch(E->getStmtClass()) {
@@ -279,8 +284,14 @@ bool ExprDetectorStmtVisitor::VisitExpr(Expr *E)
     return true;
 
   ConsumerInstance->ValidInstanceNum++;
-  if (ConsumerInstance->ValidInstanceNum ==
-      ConsumerInstance->TransformationCounter) {
+  if (ConsumerInstance->ToCounter > 0) {
+    if (ConsumerInstance->ValidInstanceNum >=
+          ConsumerInstance->TransformationCounter &&
+        ConsumerInstance->ValidInstanceNum <= ConsumerInstance->ToCounter)
+      ConsumerInstance->addOneBatchInstance(CurrentStmt, E);
+  }
+  else if (ConsumerInstance->ValidInstanceNum ==
+           ConsumerInstance->TransformationCounter) {
     ConsumerInstance->TheFunc = CurrentFuncDecl;
     ConsumerInstance->TheStmt = CurrentStmt;
     ConsumerInstance->TheExpr = E;
@@ -292,14 +303,17 @@ void ExpressionDetector::Initialize(ASTContext &context)
 {
   Transformation::Initialize(context);
   CollectionVisitor = new ExprDetectorCollectionVisitor(this);
-  if (CheckReference) {
+  // In batch mode, matches are reported through printf rather than
+  // abort, because we want to see all of them from a single run.
+  if (CheckReference && ToCounter <= 0) {
     ControlVarNamePrefix = CheckedVarNamePrefix;
     HFInfo.HeaderName = "stdlib.h";
     HFInfo.FunctionName = "abort";
     HFInfo.FunctionDeclStr = "void abort(void)";
   }
   else {
-    ControlVarNamePrefix = PrintedVarNamePrefix;
+    ControlVarNamePrefix =
+      CheckReference ? CheckedVarNamePrefix : PrintedVarNamePrefix;
     HFInfo.HeaderName = "stdio.h";
     HFInfo.FunctionName = "printf";
     HFInfo.FunctionDeclStr = "int printf(const char *format, ...)";
@@ -342,8 +356,31 @@ void ExpressionDetector::HandleTranslationUnit(ASTContext &Ctx)
     return;
   }
 
+  if (ToCounter > ValidInstanceNum) {
+    TransError = TransToCounterTooBigError;
+    return;
+  }
+
   Ctx.getDiagnostics().setSuppressAllDiagnostics(false);
 
+  if (ToCounter > 0) {
+    TransAssert(!BatchInstances.empty() && "No batch instances!");
+    if (DoReplacement) {
+      for (auto &BI : BatchInstances)
+        RewriteHelper->replaceExpr(BI.TheExpr, Replacement);
+    }
+    else {
+      ControlVarNameQueryWrap->TraverseDecl(Ctx.getTranslationUnitDecl());
+      TmpVarNameQueryWrap->TraverseDecl(Ctx.getTranslationUnitDecl());
+      doBatchRewrite();
+    }
+
+    if (Ctx.getDiagnostics().hasErrorOccurred() ||
+        Ctx.getDiagnostics().hasFatalErrorOccurred())
+      TransError = TransInternalError;
+    return;
+  }
+
   TransAssert(TheFunc && "NULL TheFunc!");
   TransAssert(TheStmt && "NULL TheStmt!");
   TransAssert(TheExpr && "NULL TheExpr");
@@ -375,6 +412,37 @@ bool ExpressionDetector::shouldAddFunctionDecl(SourceLocation Loc)
           SrcManager->isBeforeInSLocAddrSpace(Loc, HFInfo.HeaderLoc));
 }
 
+// In batch mode, we rewrite many expressions at the same time. Skip the
+// candidates whose text overlaps an already selected one, e.g., "x" in
+// "x + 1", because they cannot be replaced independently. The same is
+// true for statements that begin inside a selected expression (GNU
+// statement expressions).
+bool ExpressionDetector::overlapsBatchInstance(const Stmt *S, const Expr *E)
+{
+  SourceRange Range = getRealLocation(E->getSourceRange());
+  SourceLocation StmtLoc = getRealLocation(S->getBeginLoc());
+  for (const auto &BI : BatchInstances) {
+    SourceRange BIRange = getRealLocation(BI.TheExpr->getSourceRange());
+    if (!SrcManager->isBeforeInTranslationUnit(Range.getEnd(),
+                                               BIRange.getBegin()) &&
+        !SrcManager->isBeforeInTranslationUnit(BIRange.getEnd(),
+                                               Range.getBegin()))
+      return true;
+    if (BI.TheStmt != S &&
+        !SrcManager->isBeforeInTranslationUnit(StmtLoc, BIRange.getBegin()) &&
+        !SrcManager->isBeforeInTranslationUnit(BIRange.getEnd(), StmtLoc))
+      return true;
+  }
+  return false;
+}
+
+void ExpressionDetector::addOneBatchInstance(Stmt *S, Expr *E)
+{
+  if (overlapsBatchInstance(S, E))
+    return;
+  BatchInstances.push_back(BatchInstance(S, E, ValidInstanceNum));
+}
+
 void ExpressionDetector::addOneTempVar(const VarDecl *VD)
 {
   if (!VD)
@@ -686,42 +754,62 @@ static std::string getFormatString(const BuiltinType *BT)
   return "";
 }
 
-void ExpressionDetector::doRewrite()
+// Build the code that evaluates E into TmpVarName and then either prints
+// it or checks it against the reference value. A positive Tag is only
+// given in batch mode, where it is printed to tell the candidates apart.
+void ExpressionDetector::getCheckString(const Expr *E,
+                                        const std::string &TmpVarName,
+                                        const std::string &ControlVarName,
+                                        int Tag, std::string &Str)
 {
-  SourceLocation LocStart = TheStmt->getBeginLoc();
-  if (shouldAddFunctionDecl(LocStart)) {
-    SourceLocation Loc =
-      SrcManager->getLocForStartOfFile(SrcManager->getMainFileID());
-    TheRewriter.InsertText(Loc, HFInfo.FunctionDeclStr+";\n");
-  }
-
-  std::string Str, ExprStr, TmpVarName;
-  RewriteHelper->getExprString(TheExpr, ExprStr);
+  std::string ExprStr;
+  RewriteHelper->getExprString(E, ExprStr);
 
   std::string TyStr;
-  TheExpr->getType().getAsStringInternal(TyStr, getPrintingPolicy());
-  TmpVarName = TmpVarNamePrefix +
-               std::to_string(TmpVarNameQueryWrap->getMaxNamePostfix()+1);
+  E->getType().getAsStringInternal(TyStr, getPrintingPolicy());
   Str += TyStr + " " + TmpVarName + " = " + ExprStr + ";\n";
 
-  std::string ControlVarName = ControlVarNamePrefix +
-    std::to_string(ControlVarNameQueryWrap->getMaxNamePostfix()+1);
   Str += "static int " + ControlVarName + " = 0;\n";
   Str += "if (" + ControlVarName + " == __CVISE_INSTANCE_NUMBER) {\n";
-  if (CheckReference) {
+  if (CheckReference && Tag > 0) {
+    Str += "  if (" + TmpVarName + " == " + ReferenceValue + ") ";
+    Str += HFInfo.FunctionName;
+    Str += "(\"cvise_match_" + std::to_string(Tag) + "\\n\");\n";
+  }
+  else if (CheckReference) {
     Str += "  if (" + TmpVarName + " != " + ReferenceValue + ") ";
     Str +=  HFInfo.FunctionName + "();\n";
   }
   else {
     const Type *Ty =
-      TheExpr->getType().getTypePtr()->getUnqualifiedDesugaredType();
+      E->getType().getTypePtr()->getUnqualifiedDesugaredType();
     std::string FormatStr = getFormatString(dyn_cast<BuiltinType>(Ty));
+    std::string ValueStr = "cvise_value";
+    if (Tag > 0)
+      ValueStr += "_" + std::to_string(Tag);
     Str += "  " + HFInfo.FunctionName;
-    Str += "(\"cvise_value(%" + FormatStr + ")\\n\", ";
+    Str += "(\"" + ValueStr + "(%" + FormatStr + ")\\n\", ";
     Str += TmpVarName + ");\n";
   }
   Str += "}\n";
   Str += "++" + ControlVarName + ";";
+}
+
+void ExpressionDetector::doRewrite()
+{
+  SourceLocation LocStart = TheStmt->getBeginLoc();
+  if (shouldAddFunctionDecl(LocStart)) {
+    SourceLocation Loc =
+      SrcManager->getLocForStartOfFile(SrcManager->getMainFileID());
+    TheRewriter.InsertText(Loc, HFInfo.FunctionDeclStr+";\n");
+  }
+
+  std::string Str, TmpVarName;
+  TmpVarName = TmpVarNamePrefix +
+               std::to_string(TmpVarNameQueryWrap->getMaxNamePostfix()+1);
+  std::string ControlVarName = ControlVarNamePrefix +
+    std::to_string(ControlVarNameQueryWrap->getMaxNamePostfix()+1);
+  getCheckString(TheExpr, TmpVarName, ControlVarName, /*Tag=*/0, Str);
 
   bool NeedParen = TheStmt->getStmtClass() != Stmt::DeclStmtClass;
   RewriteHelper->addStringBeforeStmtAndReplaceExpr(TheStmt, Str,
@@ -729,6 +817,62 @@ void ExpressionDetector::doRewrite()
                                                    NeedParen);
 }
 
+void ExpressionDetector::doBatchRewrite()
+{
+  bool NeedFunctionDecl = false;
+  for (const auto &BI : BatchInstances) {
+    if (shouldAddFunctionDecl(BI.TheStmt->getBeginLoc())) {
+      NeedFunctionDecl = true;
+      break;
+    }
+  }
+  if (NeedFunctionDecl) {
+    SourceLocation Loc =
+      SrcManager->getLocForStartOfFile(SrcManager->getMainFileID());
+    TheRewriter.InsertText(Loc, HFInfo.FunctionDeclStr+";\n");
+  }
+
+  // Several candidates may come from the same statement. Their checks
+  // must be emitted together, otherwise we would wrap the statement
+  // into a new compound statement for each of them.
+  std::vector<Stmt *> Stmts;
+  std::map<Stmt *, std::vector<const BatchInstance *> > StmtToInstances;
+  for (const auto &BI : BatchInstances) {
+    auto &Instances = StmtToInstances[BI.TheStmt];
+    if (Instances.empty())
+      Stmts.push_back(BI.TheStmt);
+    Instances.push_back(&BI);
+  }
+
+  unsigned TmpVarPostfix = TmpVarNameQueryWrap->getMaxNamePostfix();
+  unsigned ControlVarPostfix = ControlVarNameQueryWrap->getMaxNamePostfix();
+  for (auto S : Stmts) {
+    const auto &Instances = StmtToInstances[S];
+    std::string Str;
+    std::vector<std::string> TmpVarNames;
+    for (auto BI : Instances) {
+      std::string TmpVarName =
+        TmpVarNamePrefix + std::to_string(++TmpVarPostfix);
+      std::string ControlVarName =
+        ControlVarNamePrefix + std::to_string(++ControlVarPostfix);
+      if (!Str.empty())
+        Str += "\n";
+      getCheckString(BI->TheExpr, TmpVarName, ControlVarName, BI->Tag, Str);
+      TmpVarNames.push_back(TmpVarName);
+    }
+
+    // The other candidates are replaced afterwards, because the closing
+    // paren is placed by the rewritten size of the statement.
+    bool NeedParen = S->getStmtClass() != Stmt::DeclStmtClass;
+    RewriteHelper->addStringBeforeStmtAndReplaceExpr(S, Str,
+                                                     Instances[0]->TheExpr,
+                                                     TmpVarNames[0],
+                                                     NeedParen);
+    for (unsigned I = 1; I < Instances.size(); ++I)
+      RewriteHelper->replaceExpr(Instances[I]->TheExpr, TmpVarNames[I]);
+  }
+}
+
 ExpressionDetector::~ExpressionDetector(void)
 {
   delete CollectionVisitor;
@@ -37,7 +37,7 @@ friend class ExprDetectorTempVarVisitor;
 
 public:
   ExpressionDetector(const char *TransName, const char *Desc)
-    : Transformation(TransName, Desc),
+    : Transformation(TransName, Desc, /*MultipleRewrites*/true),
       CollectionVisitor(NULL), ControlVarNameQueryWrap(NULL),
       TmpVarNameQueryWrap(NULL), TheFunc(NULL), TheStmt(NULL), TheExpr(NULL),
       PrintedVarNamePrefix("__cvise_printed_"),
@@ -47,6 +47,10 @@ public:
 
   ~ExpressionDetector(void);
 
+  virtual bool supportsRegion(void) {
+    return true;
+  }
+
 private:
   struct HeaderFunctionInfo {
     HeaderFunctionInfo () : HasHeader(false), HasFunction(false) { }
@@ -60,6 +64,17 @@ private:
     std::string FunctionDeclStr;
   };
 
+  // A candidate instrumented in batch mode (--to-counter). Tag is the
+  // instance number of the candidate, which is what gets printed.
+  struct BatchInstance {
+    BatchInstance(clang::Stmt *S, clang::Expr *E, int T)
+      : TheStmt(S), TheExpr(E), Tag(T) { }
+
+    clang::Stmt *TheStmt;
+    clang::Expr *TheExpr;
+    int Tag;
+  };
+
   typedef std::vector<const clang::Expr *> ExprVector;
 
   typedef std::map<const clang::Stmt *, ExprVector> StmtToExprMap;
@@ -85,8 +100,18 @@ private:
 
   bool isValidExpr(clang::Stmt *S, const clang::Expr *E);
 
+  void addOneBatchInstance(clang::Stmt *S, clang::Expr *E);
+
+  bool overlapsBatchInstance(const clang::Stmt *S, const clang::Expr *E);
+
+  void getCheckString(const clang::Expr *E, const std::string &TmpVarName,
+                      const std::string &ControlVarName, int Tag,
+                      std::string &Str);
+
   void doRewrite();
 
+  void doBatchRewrite();
+
   bool shouldAddFunctionDecl(clang::SourceLocation Loc);
 
   bool isIdenticalExpr(const clang::Expr *E1, const clang::Expr *E2);
@@ -125,6 +150,8 @@ private:
 
   HeaderFunctionInfo HFInfo;
 
+  std::vector<BatchInstance> BatchInstances;
+
   // Unimplemented
   ExpressionDetector(void);
 
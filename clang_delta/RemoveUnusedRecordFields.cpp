@@ -0,0 +1,31 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (c) 2012, 2013, 2014, 2015, 2016, 2017, 2018 The University of Utah
+// All rights reserved.
+//
+// This file is distributed under the University of Illinois Open Source
+// License.  See the file COPYING for details.
+//
+//===----------------------------------------------------------------------===//
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "RemoveUnusedStructField.h"
+
+#include "TransformationManager.h"
+
+static const char* DescriptionMsg =
+"Remove all unreferenced fields of a struct at once. \
+Each struct with at least two unreferenced fields is one instance. \
+The corresponding initialization expressions of variables declared \
+as the struct are removed as well. Structs where this fails can \
+still be reduced field by field with remove-unused-field. \n";
+
+static RegisterTransformation<RemoveUnusedStructField,
+                              RemoveUnusedStructField::EMode>
+         Trans("remove-unused-record-fields", DescriptionMsg,
+               RemoveUnusedStructField::EMode::Record);
+
+// Implementation is in RemoveUnusedStructField.cpp
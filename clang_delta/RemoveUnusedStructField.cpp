@@ -14,6 +14,8 @@
 
 #include "RemoveUnusedStructField.h"
 
+#include <algorithm>
+
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/Basic/SourceManager.h"
@@ -28,8 +30,10 @@ intialization expression for a variable declared as the struct under \
 transformation. Currenttly this pass doesn't handle nested struct \
 definition well. \n";
 
-static RegisterTransformation<RemoveUnusedStructField>
-         Trans("remove-unused-field", DescriptionMsg);
+static RegisterTransformation<RemoveUnusedStructField,
+                              RemoveUnusedStructField::EMode>
+         Trans("remove-unused-field", DescriptionMsg,
+               RemoveUnusedStructField::EMode::Field);
 
 class RemoveUnusedStructFieldVisitor : public
   RecursiveASTVisitor<RemoveUnusedStructFieldVisitor> {
@@ -41,6 +45,8 @@ public:
 
   bool VisitFieldDecl(FieldDecl *FD);
 
+  bool VisitRecordDecl(RecordDecl *RD);
+
   bool VisitDesignatedInitExpr(DesignatedInitExpr *DIE);
 
 private:
@@ -68,6 +74,9 @@ private:
 
 bool RemoveUnusedStructFieldVisitor::VisitFieldDecl(FieldDecl *FD)
 {
+  if (ConsumerInstance->Mode != RemoveUnusedStructField::EMode::Field)
+    return true;
+
   if(ConsumerInstance->isInIncludedFile(FD))
     return true;
 
@@ -85,6 +94,20 @@ bool RemoveUnusedStructFieldVisitor::VisitFieldDecl(FieldDecl *FD)
   return true;
 }
 
+bool RemoveUnusedStructFieldVisitor::VisitRecordDecl(RecordDecl *RD)
+{
+  if (ConsumerInstance->Mode != RemoveUnusedStructField::EMode::Record)
+    return true;
+
+  if (ConsumerInstance->isInIncludedFile(RD) ||
+      !RD->isThisDeclarationADefinition() || !RD->isStruct() ||
+      ConsumerInstance->isSpecialRecordDecl(RD))
+    return true;
+
+  ConsumerInstance->handleOneRecordDef(RD);
+  return true;
+}
+
 bool RemoveUnusedStructFieldVisitor::VisitDesignatedInitExpr(DesignatedInitExpr *DIE) {
   return true;
 }
@@ -144,7 +167,8 @@ void RemoveUnusedStructField::HandleTranslationUnit(ASTContext &Ctx)
   Ctx.getDiagnostics().setSuppressAllDiagnostics(false);
 
   TransAssert(TheRecordDecl && "NULL TheRecordDecl!");
-  TransAssert(TheFieldDecl && "NULL TheFunctionDecl!");
+  TransAssert((TheFieldDecl || !TheFieldDecls.empty()) &&
+              "NULL TheFieldDecl!");
   
   RewriteVisitor->TraverseDecl(Ctx.getTranslationUnitDecl());
   removeFieldDecl();
@@ -176,6 +200,50 @@ void RemoveUnusedStructField::setBaseLine(const RecordDecl *RD,
   }
 }
   
+// Each struct with at least two unreferenced fields makes one instance,
+// the structs with a single one are left to remove-unused-field.
+// We skip fields sharing a declaration with other fields, e.g.,
+// "int f1, f2;", because removing them one by one would remove
+// overlapping source ranges.
+void RemoveUnusedStructField::handleOneRecordDef(const RecordDecl *RD)
+{
+  llvm::SmallVector<const FieldDecl *, 16> AllFields(RD->field_begin(),
+                                                     RD->field_end());
+  llvm::SmallVector<const FieldDecl *, 8> Fields;
+  for (unsigned I = 0; I < AllFields.size(); ++I) {
+    const FieldDecl *FD = AllFields[I];
+    if (FD->isReferenced() || isInIncludedFile(FD))
+      continue;
+    SourceLocation Loc = FD->getBeginLoc();
+    if ((I > 0 && AllFields[I - 1]->getBeginLoc() == Loc) ||
+        (I + 1 < AllFields.size() && AllFields[I + 1]->getBeginLoc() == Loc))
+      continue;
+    Fields.push_back(FD);
+  }
+
+  if (Fields.size() < 2)
+    return;
+
+  ValidInstanceNum++;
+  if (ValidInstanceNum == TransformationCounter)
+    setRecordBaseLine(RD, Fields);
+}
+
+void RemoveUnusedStructField::setRecordBaseLine(const RecordDecl *RD,
+       const llvm::SmallVectorImpl<const FieldDecl *> &Fields)
+{
+  TheRecordDecl = RD;
+
+  IndexVector *IdxVec = new IndexVector();
+  for (auto FD : Fields) {
+    TheFieldDecls.push_back(FD);
+    TheFieldDeclSet.insert(FD);
+    IdxVec->push_back(FD->getFieldIndex());
+    FieldToIdxVector[FD] = IdxVec;
+  }
+  RecordDeclToField[RD] = IdxVec;
+}
+
 void RemoveUnusedStructField::handleOneRecordDecl(const RecordDecl *RD,
                                                   const RecordDecl *BaseRD,
                                                   const FieldDecl *FD,
@@ -216,7 +284,10 @@ void RemoveUnusedStructField::handleOneVarDecl(const VarDecl *VD)
        E = InitExprs.end(); I != E; ++I) {
     if (dyn_cast<ImplicitValueInitExpr>(*I))
       continue;
-    removeOneInitExpr(*I);
+    if (Mode == EMode::Record)
+      removeRecordInitExprs(cast<InitListExpr>(*I));
+    else
+      removeOneInitExpr(*I);
   }
 }
 
@@ -327,6 +398,13 @@ void RemoveUnusedStructField::getInitExprs(const Type *Ty,
   }
 
   const RecordDecl *RD = RT->getDecl();
+  // In Record mode, we collect the whole initializer list of the
+  // struct and remove its elements together.
+  if (Mode == EMode::Record && RD->getDefinition() == TheRecordDecl) {
+    InitExprs.push_back(ILE);
+    return;
+  }
+
   unsigned int VecSz = IdxVec->size();
   for (IndexVector::const_iterator FI = IdxVec->begin(),
        FE = IdxVec->end(); FI != FE; ++FI)
@@ -381,7 +459,19 @@ void RemoveUnusedStructField::removeOneInitExpr(const Expr *E)
 
     return;
   }
-  else if (IsFirstField) {
+  removeInitExprAndComma(E, IsFirstField);
+}
+
+// Remove E together with either the comma following it or the one
+// preceding it.
+void RemoveUnusedStructField::removeInitExprAndComma(const Expr *E,
+                                                     bool FollowingComma)
+{
+  SourceRange ExpRange = E->getSourceRange();
+  SourceLocation StartLoc = ExpRange.getBegin();
+  SourceLocation EndLoc = ExpRange.getEnd();
+
+  if (FollowingComma) {
     EndLoc = RewriteHelper->getEndLocationUntil(ExpRange, ',');
     TheRewriter.RemoveText(SourceRange(StartLoc, EndLoc));
     return;
@@ -397,6 +487,75 @@ void RemoveUnusedStructField::removeOneInitExpr(const Expr *E)
   TheRewriter.RemoveText(SourceRange(StartLoc, EndLoc));
 }
 
+// Remove the initializers of all fields in TheFieldDecls from ILE,
+// which initializes TheRecordDecl. Each comma is owned by exactly one
+// removed initializer: an initializer followed by a kept one takes the
+// comma after it, otherwise it takes the comma before it. This way the
+// removed source ranges never overlap.
+void RemoveUnusedStructField::removeRecordInitExprs(const InitListExpr *ILE)
+{
+  ExprVector Inits;
+  llvm::SmallVector<bool, 16> Removed;
+  int FieldIdx = -1;
+  for (unsigned I = 0; I < ILE->getNumInits(); ++I) {
+    const Expr *Init = ILE->getInit(I);
+    if (isa<ImplicitValueInitExpr>(Init))
+      continue;
+
+    const FieldDecl *FD = NULL;
+    if (const DesignatedInitExpr *DIE = dyn_cast<DesignatedInitExpr>(Init)) {
+      const DesignatedInitExpr::Designator *DS = DIE->getDesignator(0);
+      if (DS->isFieldDesignator()) {
+#if LLVM_VERSION_MAJOR >= 17
+        FD = DS->getFieldDecl();
+#else
+        FD = DS->getField();
+#endif
+        if (!FD) {
+          for (auto F : TheRecordDecl->fields()) {
+            if (F->getIdentifier() == DS->getFieldName()) {
+              FD = F;
+              break;
+            }
+          }
+        }
+      }
+      if (FD)
+        FieldIdx = FD->getFieldIndex();
+    }
+    else {
+      FieldIdx++;
+      FD = getFieldDeclByIdx(TheRecordDecl, FieldIdx);
+    }
+    Inits.push_back(Init);
+    Removed.push_back(FD && TheFieldDeclSet.count(FD));
+  }
+
+  unsigned NumInits = Inits.size();
+  unsigned NumRemoved = std::count(Removed.begin(), Removed.end(), true);
+  if (!NumRemoved)
+    return;
+
+  if (NumRemoved == NumInits) {
+    // Same as removing the only field in removeOneInitExpr
+    SourceLocation StartLoc = Inits.front()->getSourceRange().getBegin();
+    SourceLocation EndLoc =
+      RewriteHelper->getEndLocationUntil(Inits.back()->getSourceRange(), '}');
+    EndLoc = EndLoc.getLocWithOffset(-1);
+    TheRewriter.RemoveText(SourceRange(StartLoc, EndLoc));
+    return;
+  }
+
+  bool KeptAfter = false;
+  for (int I = NumInits - 1; I >= 0; --I) {
+    if (!Removed[I]) {
+      KeptAfter = true;
+      continue;
+    }
+    removeInitExprAndComma(Inits[I], KeptAfter);
+  }
+}
+
 const RecordDecl *RemoveUnusedStructField::getBaseRecordDef(const Type *Ty)
 {
   const ArrayType *ArrayTy = dyn_cast<ArrayType>(Ty);
@@ -413,6 +572,12 @@ const RecordDecl *RemoveUnusedStructField::getBaseRecordDef(const Type *Ty)
 
 void RemoveUnusedStructField::removeFieldDecl(void)
 {
+  if (Mode == EMode::Record) {
+    for (auto FD : TheFieldDecls)
+      RewriteHelper->removeFieldDecl(FD);
+    return;
+  }
+
   // FIXME: we don't handle nested struct definition well.
   // For example,
   // struct S1 {
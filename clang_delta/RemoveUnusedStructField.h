@@ -13,11 +13,14 @@
 
 #include "Transformation.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 
 namespace clang {
   class DeclGroupRef;
   class ASTContext;
   class FieldDecl;
+  class InitListExpr;
   class RecordDecl;
   class Type;
   class VarDecl;
@@ -32,14 +35,19 @@ friend class RemoveUnusedStructFieldRewriteVisitor;
 
 public:
 
-  RemoveUnusedStructField(const char *TransName, const char *Desc)
+  // Field removes one unused field per instance, Record removes all
+  // unused fields of one struct per instance.
+  enum class EMode { Field, Record };
+
+  RemoveUnusedStructField(const char *TransName, const char *Desc, EMode Mode)
     : Transformation(TransName, Desc),
       CollectionVisitor(NULL),
       RewriteVisitor(NULL),
       TheRecordDecl(NULL),
       TheFieldDecl(NULL),
       NumFields(0),
-      IsFirstField(false)
+      IsFirstField(false),
+      Mode(Mode)
   { }
 
   ~RemoveUnusedStructField(void);
@@ -66,6 +74,11 @@ private:
 
   void setBaseLine(const clang::RecordDecl *RD, const clang::FieldDecl *FD);
 
+  void handleOneRecordDef(const clang::RecordDecl *RD);
+
+  void setRecordBaseLine(const clang::RecordDecl *RD,
+         const llvm::SmallVectorImpl<const clang::FieldDecl *> &Fields);
+
   const clang::Expr *getInitExprFromDesignatedInitExpr(
                        const clang::InitListExpr *ILE, int InitListIdx,
                        const clang::FieldDecl *FD);
@@ -77,6 +90,10 @@ private:
 
   void removeOneInitExpr(const clang::Expr *E);
 
+  void removeInitExprAndComma(const clang::Expr *E, bool FollowingComma);
+
+  void removeRecordInitExprs(const clang::InitListExpr *ILE);
+
   void removeFieldDecl(void);
 
   RecordDeclToFieldIdxVectorMap RecordDeclToField;
@@ -91,10 +108,16 @@ private:
 
   const clang::FieldDecl *TheFieldDecl;
 
+  llvm::SmallVector<const clang::FieldDecl *, 8> TheFieldDecls;
+
+  llvm::SmallPtrSet<const clang::FieldDecl *, 8> TheFieldDeclSet;
+
   unsigned int NumFields;
 
   bool IsFirstField;
 
+  EMode Mode;
+
   // Unimplemented
   RemoveUnusedStructField(void);
 
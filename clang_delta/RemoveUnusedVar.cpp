@@ -50,7 +50,8 @@ private:
 
 bool RemoveUnusedVarAnalysisVisitor::VisitVarDecl(VarDecl *VD)
 {
-  if (ConsumerInstance->isInIncludedFile(VD))
+  if (ConsumerInstance->isInIncludedFile(VD) ||
+      !ConsumerInstance->isInRegion(VD))
     return true;
 
   if (VD->isReferenced() || dyn_cast<ParmVarDecl>(VD) || 
@@ -116,7 +117,7 @@ bool RemoveUnusedVar::HandleTopLevelDecl(DeclGroupRef D)
  
 void RemoveUnusedVar::HandleTranslationUnit(ASTContext &Ctx)
 {
-  AnalysisVisitor->TraverseDecl(Ctx.getTranslationUnitDecl());
+  traverseRegion(AnalysisVisitor, Ctx.getTranslationUnitDecl());
 
   if (QueryInstanceOnly)
     return;
@@ -38,6 +38,10 @@ public:
 
   ~RemoveUnusedVar(void);
 
+  virtual bool supportsRegion(void) {
+    return true;
+  }
+
 private:
   virtual void Initialize(clang::ASTContext &context);
 
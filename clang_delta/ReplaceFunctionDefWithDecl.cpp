@@ -48,7 +48,8 @@ private:
 bool ReplaceFunctionDefWithDeclCollectionVisitor::VisitFunctionDecl(
        FunctionDecl *FD)
 {
-  if (ConsumerInstance->isInIncludedFile(FD))
+  if (ConsumerInstance->isInIncludedFile(FD) ||
+      !ConsumerInstance->isInRegion(FD))
     return true;
 
   if (FD->isThisDeclarationADefinition() && 
@@ -68,7 +69,7 @@ void ReplaceFunctionDefWithDecl::Initialize(ASTContext &context)
 
 void ReplaceFunctionDefWithDecl::HandleTranslationUnit(ASTContext &Ctx)
 {
-  CollectionVisitor->TraverseDecl(Ctx.getTranslationUnitDecl());
+  traverseRegion(CollectionVisitor, Ctx.getTranslationUnitDecl());
 
   if (QueryInstanceOnly)
     return;
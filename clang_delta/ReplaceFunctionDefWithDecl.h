@@ -40,6 +40,10 @@ public:
 
   ~ReplaceFunctionDefWithDecl();
 
+  virtual bool supportsRegion(void) {
+    return true;
+  }
+
 private:
   
   typedef llvm::SmallVector<const clang::FunctionDecl *, 500>
@@ -198,20 +198,22 @@ clang::SourceRange RewriteUtils::getDeclFullSourceRange(const clang::Decl* D)
 
 
   // Include the semicolon into the declaration. 
-  // See DeclPrinter::VisitDeclContext in clang source code for all cases.
-  bool HasSemicolon = true;
-  if (auto* FD = dyn_cast<FunctionDecl>(D)) {
-    HasSemicolon = !FD->doesThisDeclarationHaveABody();
-  } else if (auto* FTD = dyn_cast<FunctionTemplateDecl>(D)) {
-    HasSemicolon = !FTD->getTemplatedDecl()->isThisDeclarationADefinition();
-  }
-
-  if (HasSemicolon)
+  if (hasTrailingSemicolon(D))
     Range.setEnd(getEndLocationAfter(Range, ';'));
 
   return Range;
 }
 
+// See DeclPrinter::VisitDeclContext in clang source code for all cases.
+bool RewriteUtils::hasTrailingSemicolon(const clang::Decl* D)
+{
+  if (auto* FD = dyn_cast<FunctionDecl>(D))
+    return !FD->doesThisDeclarationHaveABody();
+  if (auto* FTD = dyn_cast<FunctionTemplateDecl>(D))
+    return !FTD->getTemplatedDecl()->isThisDeclarationADefinition();
+  return true;
+}
+
 SourceLocation RewriteUtils::getLocationAfter(SourceLocation Loc, 
                                                 char Symbol)
 {
@@ -282,6 +282,11 @@ public:
   clang::SourceLocation getLocationAfterSkiping(clang::SourceLocation StartLoc,
                                                 char Symbol);
 
+  // Return true if the full source range of D ends with a semicolon.
+  // In that case, the end of getDeclFullSourceRange(D) points right
+  // after the semicolon; otherwise it points to the closing brace.
+  bool hasTrailingSemicolon(const clang::Decl* D);
+
   clang::SourceRange getDeclFullSourceRange(const clang::Decl* D);
 
 private:
@@ -64,7 +64,8 @@ private:
 
 bool SimplifyCallExprVisitor::VisitCallExpr(CallExpr *CE)
 {
-  if (ConsumerInstance->isInIncludedFile(CE))
+  if (ConsumerInstance->isInIncludedFile(CE) ||
+      !ConsumerInstance->isInRegion(CE))
     return true;
 
   ConsumerInstance->ValidInstanceNum++;
@@ -93,7 +94,7 @@ void SimplifyCallExpr::Initialize(ASTContext &context)
 
 void SimplifyCallExpr::HandleTranslationUnit(ASTContext &Ctx)
 {
-  CollectionVisitor->TraverseDecl(Ctx.getTranslationUnitDecl());
+  traverseRegion(CollectionVisitor, Ctx.getTranslationUnitDecl());
   if (QueryInstanceOnly)
     return;
 
@@ -81,7 +81,8 @@ private:
 bool SimplifyIfCollectionVisitor::VisitFunctionDecl(FunctionDecl *FD)
 {
   if (ConsumerInstance->isInIncludedFile(FD) ||
-      !FD->isThisDeclarationADefinition())
+      !FD->isThisDeclarationADefinition() ||
+      ConsumerInstance->isOutsideRegion(FD))
     return true;
 
   ConsumerInstance->StmtVisitor->TraverseDecl(FD);
@@ -99,11 +100,14 @@ bool SimplifyIfStatementVisitor::VisitIfStmt(IfStmt *IS)
     return false;
   }
 
-  ConsumerInstance->ValidInstanceNum++;
-  if (ConsumerInstance->ValidInstanceNum == 
-      ConsumerInstance->TransformationCounter) {
-    ConsumerInstance->TheIfStmt = IS;
-    ConsumerInstance->NeedParen = NeedParen;
+  // Nested statements can still be inside of the region.
+  if (ConsumerInstance->isInRegion(IS)) {
+    ConsumerInstance->ValidInstanceNum++;
+    if (ConsumerInstance->ValidInstanceNum == 
+        ConsumerInstance->TransformationCounter) {
+      ConsumerInstance->TheIfStmt = IS;
+      ConsumerInstance->NeedParen = NeedParen;
+    }
   }
 
   Stmt *ThenB = IS->getThen();
@@ -1139,6 +1139,142 @@ SourceRange Transformation::getRealLocation(const SourceRange& Range) const
   return SourceRange(getRealLocation(Range.getBegin()), getRealLocation(Range.getEnd()));
 }
 
+// Compute the lines of Range in the main file. Return false if Range
+// doesn't start and end in the main file.
+bool Transformation::getLineRange(const SourceRange &Range,
+                                  unsigned &BeginLine, unsigned &EndLine)
+{
+  SourceRange RealRange = getRealLocation(Range);
+  SourceLocation BeginLoc = RealRange.getBegin();
+  SourceLocation EndLoc = RealRange.getEnd();
+  if (BeginLoc.isInvalid() || EndLoc.isInvalid() ||
+      isInIncludedFile(BeginLoc) || isInIncludedFile(EndLoc))
+    return false;
+
+  BeginLine = SrcManager->getExpansionLineNumber(BeginLoc);
+  EndLine = SrcManager->getExpansionLineNumber(EndLoc);
+  return true;
+}
+
+static bool isRegionDeclDefinition(const Decl *D)
+{
+  if (const FunctionDecl *FD = dyn_cast<FunctionDecl>(D))
+    return FD->isThisDeclarationADefinition();
+  if (const FunctionTemplateDecl *FTD = dyn_cast<FunctionTemplateDecl>(D))
+    return FTD->isThisDeclarationADefinition();
+  if (const TagDecl *TD = dyn_cast<TagDecl>(D))
+    return TD->isThisDeclarationADefinition();
+  if (const ClassTemplateDecl *CTD = dyn_cast<ClassTemplateDecl>(D))
+    return CTD->isThisDeclarationADefinition();
+  return true;
+}
+
+// Look up a declaration named Name in D and, for namespaces and
+// records, in its members. Definitions are preferred over declarations.
+static const NamedDecl *findRegionDecl(const Decl *D,
+                                       const std::string &Name,
+                                       const SourceManager &SrcManager)
+{
+  if (D->isImplicit())
+    return NULL;
+
+  SourceLocation Loc = SrcManager.getExpansionLoc(D->getLocation());
+  if (SrcManager.getFileID(Loc) != SrcManager.getMainFileID())
+    return NULL;
+
+  const NamedDecl *Found = NULL;
+  const NamedDecl *ND = dyn_cast<NamedDecl>(D);
+  if (ND && ND->getQualifiedNameAsString() == Name) {
+    if (isRegionDeclDefinition(ND))
+      return ND;
+    Found = ND;
+  }
+
+  if (!isa<NamespaceDecl>(D) && !isa<LinkageSpecDecl>(D) &&
+      !isa<RecordDecl>(D))
+    return Found;
+
+  const DeclContext *Ctx = dyn_cast<DeclContext>(D);
+  for (DeclContext::decl_iterator I = Ctx->decls_begin(),
+       E = Ctx->decls_end(); I != E; ++I) {
+    const NamedDecl *Inner = findRegionDecl(*I, Name, SrcManager);
+    if (Inner && isRegionDeclDefinition(Inner))
+      return Inner;
+    if (Inner && !Found)
+      Found = Inner;
+  }
+  return Found;
+}
+
+// Turn the name given by --decl into a line range. Collection may
+// run from HandleTopLevelDecl while the translation unit is still
+// incomplete, so we only scan the top-level declarations added since
+// the last call, and stop once a definition is found. Until then, the
+// region is either empty or the first declaration seen.
+void Transformation::resolveRegionDecl()
+{
+  if (RegionDeclName.empty() || RegionDeclResolved)
+    return;
+
+  TranslationUnitDecl *TU = Context->getTranslationUnitDecl();
+  DeclContext::decl_iterator I = TU->decls_begin();
+  if (RegionLastScannedDecl)
+    I = ++DeclContext::decl_iterator(RegionLastScannedDecl);
+
+  for (DeclContext::decl_iterator E = TU->decls_end(); I != E; ++I) {
+    RegionLastScannedDecl = (*I);
+    const NamedDecl *ND = findRegionDecl(*I, RegionDeclName, *SrcManager);
+    if (!ND)
+      continue;
+
+    bool IsDefinition = isRegionDeclDefinition(ND);
+    unsigned BeginLine, EndLine;
+    if ((IsDefinition || !RegionStartLine) &&
+        getLineRange(ND->getSourceRange(), BeginLine, EndLine)) {
+      RegionStartLine = BeginLine;
+      RegionEndLine = EndLine;
+    }
+    if (IsDefinition) {
+      RegionDeclResolved = true;
+      return;
+    }
+  }
+}
+
+bool Transformation::isInRegion(const SourceRange &Range)
+{
+  if (!hasRegion())
+    return true;
+
+  resolveRegionDecl();
+  unsigned BeginLine, EndLine;
+  if (!getLineRange(Range, BeginLine, EndLine))
+    return false;
+  return (BeginLine >= RegionStartLine) && (EndLine <= RegionEndLine);
+}
+
+bool Transformation::isInRegion(const Decl *D)
+{
+  return isInRegion(D->getSourceRange());
+}
+
+bool Transformation::isInRegion(const Stmt *S)
+{
+  return isInRegion(S->getSourceRange());
+}
+
+bool Transformation::isOutsideRegion(const Decl *D)
+{
+  if (!hasRegion())
+    return false;
+
+  resolveRegionDecl();
+  unsigned BeginLine, EndLine;
+  if (!getLineRange(D->getSourceRange(), BeginLine, EndLine))
+    return true;
+  return (EndLine < RegionStartLine) || (BeginLine > RegionEndLine);
+}
+
 bool Transformation::isDeclaringRecordDecl(const RecordDecl *RD)
 {
   SourceLocation SemiLoc =
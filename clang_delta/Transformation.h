@@ -16,6 +16,7 @@
 #include <cassert>
 #include "llvm/ADT/SmallPtrSet.h"
 #include "clang/AST/ASTConsumer.h"
+#include "clang/AST/Decl.h"
 #include "clang/AST/PrettyPrinter.h"
 #include "clang/Rewrite/Core/Rewriter.h"
 #include "RewriteUtils.h"
@@ -87,7 +88,11 @@ public:
       DoReplacement(false),
       DoPreserveRoutine(false),
       CheckReference(false),
-      WarnOnCounterOutOfBounds(false)
+      WarnOnCounterOutOfBounds(false),
+      RegionStartLine(0),
+      RegionEndLine(0),
+      RegionDeclResolved(false),
+      RegionLastScannedDecl(NULL)
   {
     // Nothing to do
   }
@@ -110,7 +115,11 @@ public:
       DoReplacement(false),
       DoPreserveRoutine(false),
       CheckReference(false),
-      WarnOnCounterOutOfBounds(false)
+      WarnOnCounterOutOfBounds(false),
+      RegionStartLine(0),
+      RegionEndLine(0),
+      RegionDeclResolved(false),
+      RegionLastScannedDecl(NULL)
   {
     // Nothing to do
   }
@@ -138,6 +147,21 @@ public:
     WarnOnCounterOutOfBounds = Flag;
   }
 
+  void setRegion(unsigned StartLine, unsigned EndLine) {
+    RegionStartLine = StartLine;
+    RegionEndLine = EndLine;
+  }
+
+  void setRegionDecl(const std::string &Name) {
+    RegionDeclName = Name;
+  }
+
+  // Transformations which only collect instances inside the region
+  // given by --range or --decl override this.
+  virtual bool supportsRegion() {
+    return false;
+  }
+
   bool isMultipleRewritesEnabled() {
     return MultipleRewrites;
   }
@@ -325,6 +349,36 @@ protected:
 
   bool isDeclaringRecordDecl(const clang::RecordDecl *RD);
 
+  bool hasRegion() const {
+    return (RegionStartLine > 0) || !RegionDeclName.empty();
+  }
+
+  // Return true if the range lies entirely inside of the region.
+  // Always true if no region is given.
+  bool isInRegion(const clang::SourceRange &Range);
+
+  bool isInRegion(const clang::Decl *D);
+
+  bool isInRegion(const clang::Stmt *S);
+
+  // Return true if no part of D overlaps the region, so collection
+  // visitors can skip D as a whole.
+  bool isOutsideRegion(const clang::Decl *D);
+
+  // Traverse TU with Visitor, skipping the top-level declarations
+  // outside of the region.
+  template<typename VisitorTy>
+  void traverseRegion(VisitorTy *Visitor, clang::TranslationUnitDecl *TU) {
+    if (!hasRegion()) {
+      Visitor->TraverseDecl(TU);
+      return;
+    }
+    for (auto *D : TU->decls()) {
+      if (!isOutsideRegion(D))
+        Visitor->TraverseDecl(D);
+    }
+  }
+
   clang::PrintingPolicy getPrintingPolicy() const;
 
   // If the location is a MacroID, get its expansion location.
@@ -373,6 +427,23 @@ protected:
   std::string ReferenceValue;
 
   bool WarnOnCounterOutOfBounds;
+
+private:
+
+  void resolveRegionDecl();
+
+  bool getLineRange(const clang::SourceRange &Range,
+                    unsigned &BeginLine, unsigned &EndLine);
+
+  unsigned RegionStartLine;
+
+  unsigned RegionEndLine;
+
+  std::string RegionDeclName;
+
+  bool RegionDeclResolved;
+
+  clang::Decl *RegionLastScannedDecl;
 };
 
 class TransNameQueryVisitor;
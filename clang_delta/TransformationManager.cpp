@@ -30,6 +30,7 @@
 #include "clang/Parse/ParseAST.h"
 
 #include "Transformation.h"
+#include "EmitTopForms.h"
 
 using namespace std;
 using namespace clang;
@@ -38,7 +39,7 @@ int TransformationManager::ErrorInvalidCounter = 1;
 
 TransformationManager* TransformationManager::Instance;
 
-std::map<std::string, Transformation *> *
+std::map<std::string, TransformationManager::TransformationEntry> *
 TransformationManager::TransformationsMapPtr;
 
 TransformationManager *TransformationManager::GetInstance()
@@ -49,11 +50,23 @@ TransformationManager *TransformationManager::GetInstance()
   TransformationManager::Instance = new TransformationManager();
   assert(TransformationManager::Instance);
 
-  TransformationManager::Instance->TransformationsMap = 
-    *TransformationManager::TransformationsMapPtr;
   return TransformationManager::Instance;
 }
 
+int TransformationManager::setTransformation(const std::string &Trans)
+{
+  std::map<std::string, TransformationEntry>::iterator I =
+    TransformationsMapPtr->find(Trans);
+  if (I == TransformationsMapPtr->end())
+    return -1;
+
+  // Only the last given transformation is used
+  delete CurrentTransformationImpl;
+  CurrentTransName = Trans;
+  CurrentTransformationImpl = (*I).second.Create();
+  return 0;
+}
+
 Preprocessor &TransformationManager::getPreprocessor()
 {
   return GetInstance()->ClangInstance->getPreprocessor();
@@ -261,7 +274,9 @@ bool TransformationManager::initializeCompilerInstance(std::string &ErrorMsg)
     } while(next != npos);
   }
 
-  ClangInstance->createFileManager();
+  // The OpenCL setup above has created one already
+  if (!ClangInstance->hasFileManager())
+    ClangInstance->createFileManager();
   ClangInstance->createSourceManager(ClangInstance->getFileManager());
   ClangInstance->createPreprocessor(TU_Complete);
 
@@ -300,14 +315,9 @@ void TransformationManager::Finalize()
 {
   assert(TransformationManager::Instance);
   
-  std::map<std::string, Transformation *>::iterator I, E;
-  for (I = Instance->TransformationsMap.begin(), 
-       E = Instance->TransformationsMap.end();
-       I != E; ++I) {
-    // CurrentTransformationImpl will be freed by ClangInstance
-    if ((*I).second != Instance->CurrentTransformationImpl)
-      delete (*I).second;
-  }
+  // Otherwise, CurrentTransformationImpl will be freed by ClangInstance
+  if (!Instance->ClangInstance || !Instance->ClangInstance->hasASTConsumer())
+    delete Instance->CurrentTransformationImpl;
   delete Instance->TransformationsMapPtr;
   delete Instance->ClangInstance;
   delete Instance;
@@ -356,11 +366,23 @@ bool TransformationManager::doTransformation(std::string &ErrorMsg, int &ErrorCo
       return false;
     }
   }
+  if (RegionStartLine > 0)
+    CurrentTransformationImpl->setRegion(RegionStartLine, RegionEndLine);
+  if (!RegionDeclName.empty())
+    CurrentTransformationImpl->setRegionDecl(RegionDeclName);
 
   ParseAST(ClangInstance->getSema());
 
   ClangInstance->getDiagnosticClient().EndSourceFile();
 
+  if (DoEmitTopForms) {
+    llvm::raw_ostream *OutStream = getOutStream();
+    static_cast<EmitTopForms *>(CurrentTransformationImpl)
+      ->outputTopForms(*OutStream);
+    closeOutStream(OutStream);
+    return true;
+  }
+
   if (QueryInstanceOnly) {
     return true;
   }
@@ -387,11 +409,33 @@ bool TransformationManager::doTransformation(std::string &ErrorMsg, int &ErrorCo
 
 bool TransformationManager::verify(std::string &ErrorMsg, int &ErrorCode)
 {
+  if (DoEmitTopForms) {
+    if (CurrentTransformationImpl) {
+      ErrorMsg = "--emit-topforms cannot be used with a transformation!";
+      return false;
+    }
+    CurrentTransName = "emit-topforms";
+    CurrentTransformationImpl = new EmitTopForms("emit-topforms", "");
+  }
+
   if (!CurrentTransformationImpl) {
     ErrorMsg = "Empty transformation instance!";
     return false;
   }
 
+  if ((RegionStartLine > 0) || !RegionDeclName.empty()) {
+    if ((RegionStartLine > 0) && !RegionDeclName.empty()) {
+      ErrorMsg = "--range and --decl cannot be used together!";
+      return false;
+    }
+    if (!CurrentTransformationImpl->supportsRegion()) {
+      ErrorMsg = "current transformation[";
+      ErrorMsg += CurrentTransName;
+      ErrorMsg += "] does not support --range or --decl!";
+      return false;
+    }
+  }
+
   if (CurrentTransformationImpl->skipCounter())
     return true;
 
@@ -412,38 +456,42 @@ bool TransformationManager::verify(std::string &ErrorMsg, int &ErrorCode)
 
 void TransformationManager::registerTransformation(
        const char *TransName, 
-       Transformation *TransImpl)
+       const char *Desc,
+       std::function<Transformation *()> Create)
 {
   if (!TransformationManager::TransformationsMapPtr) {
     TransformationManager::TransformationsMapPtr = 
-      new std::map<std::string, Transformation *>();
+      new std::map<std::string, TransformationEntry>();
   }
 
-  assert((TransImpl != NULL) && "NULL Transformation!");
+  assert(Create && "NULL Transformation factory!");
   assert((TransformationManager::TransformationsMapPtr->find(TransName) == 
           TransformationManager::TransformationsMapPtr->end()) &&
          "Duplicated transformation!");
-  (*TransformationManager::TransformationsMapPtr)[TransName] = TransImpl;
+  TransformationEntry &Entry =
+    (*TransformationManager::TransformationsMapPtr)[TransName];
+  Entry.Description = Desc;
+  Entry.Create = Create;
 }
 
 void TransformationManager::printTransformations()
 {
   llvm::outs() << "Registered Transformations:\n";
 
-  std::map<std::string, Transformation *>::iterator I, E;
-  for (I = TransformationsMap.begin(), 
-       E = TransformationsMap.end();
+  std::map<std::string, TransformationEntry>::iterator I, E;
+  for (I = TransformationsMapPtr->begin(), 
+       E = TransformationsMapPtr->end();
        I != E; ++I) {
     llvm::outs() << "  [" << (*I).first << "]: "; 
-    llvm::outs() << (*I).second->getDescription() << "\n";
+    llvm::outs() << (*I).second.Description << "\n";
   }
 }
 
 void TransformationManager::printTransformationNames()
 {
-  std::map<std::string, Transformation *>::iterator I, E;
-  for (I = TransformationsMap.begin(), 
-       E = TransformationsMap.end();
+  std::map<std::string, TransformationEntry>::iterator I, E;
+  for (I = TransformationsMapPtr->begin(), 
+       E = TransformationsMapPtr->end();
        I != E; ++I) {
     llvm::outs() << (*I).first << "\n";
   }
@@ -483,7 +531,11 @@ TransformationManager::TransformationManager()
     SetCXXStandard(false),
     CXXStandard(""),
     WarnOnCounterOutOfBounds(false),
-    ReportInstancesCount(false)
+    ReportInstancesCount(false),
+    RegionStartLine(0),
+    RegionEndLine(0),
+    RegionDeclName(""),
+    DoEmitTopForms(false)
 {
   // Nothing to do
 }
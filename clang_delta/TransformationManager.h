@@ -13,6 +13,7 @@
 
 #include <string>
 #include <map>
+#include <functional>
 #include <cassert>
 
 #include "llvm/Support/raw_ostream.h"
@@ -27,12 +28,22 @@ class TransformationManager {
 
 public:
 
+  // Transformations are only constructed when they are selected,
+  // so the registry keeps a factory for each of them. This is the
+  // startup saving for all input languages; the compiler instance
+  // itself is still set up in full, as every input is parsed.
+  struct TransformationEntry {
+    const char *Description;
+    std::function<Transformation *()> Create;
+  };
+
   static TransformationManager *GetInstance();
 
   static void Finalize();
 
   static void registerTransformation(const char *TransName, 
-                                     Transformation *TransImpl);
+                                     const char *Desc,
+                                     std::function<Transformation *()> Create);
   
   static bool isCXXLangOpt();
 
@@ -48,13 +59,7 @@ public:
 
   bool verify(std::string &ErrorMsg, int &ErrorCode);
 
-  int setTransformation(const std::string &Trans) {
-    if (TransformationsMap.find(Trans.c_str()) == TransformationsMap.end())
-      return -1;
-    CurrentTransName = Trans;
-    CurrentTransformationImpl = TransformationsMap[Trans.c_str()];
-    return 0;
-  }
+  int setTransformation(const std::string &Trans);
 
   void setTransformationCounter(int Counter) {
     assert((Counter > 0) && "Bad Counter value!");
@@ -115,6 +120,20 @@ public:
     WarnOnCounterOutOfBounds = Flag;
   }
 
+  void setRegion(unsigned StartLine, unsigned EndLine) {
+    assert((StartLine > 0) && (StartLine <= EndLine) && "Bad region!");
+    RegionStartLine = StartLine;
+    RegionEndLine = EndLine;
+  }
+
+  void setRegionDecl(const std::string &Name) {
+    RegionDeclName = Name;
+  }
+
+  void setEmitTopForms(bool Flag) {
+    DoEmitTopForms = Flag;
+  }
+
   bool initializeCompilerInstance(std::string &ErrorMsg);
 
   void outputNumTransformationInstances();
@@ -137,9 +156,7 @@ private:
 
   static TransformationManager *Instance;
 
-  static std::map<std::string, Transformation *> *TransformationsMapPtr;
-
-  std::map<std::string, Transformation *> TransformationsMap;
+  static std::map<std::string, TransformationEntry> *TransformationsMapPtr;
 
   Transformation *CurrentTransformationImpl;
 
@@ -177,6 +194,14 @@ private:
 
   bool ReportInstancesCount;
 
+  unsigned RegionStartLine;
+
+  unsigned RegionEndLine;
+
+  std::string RegionDeclName;
+
+  bool DoEmitTopForms;
+
   // Unimplemented
   TransformationManager(const TransformationManager &);
 
@@ -189,10 +214,13 @@ class RegisterTransformation {
 
 public:
   RegisterTransformation(const char *TransName, const char *Desc, Args... args) {
-    Transformation *TransImpl = new TransformationClass(TransName, Desc, args...);
-    assert(TransImpl && "Fail to create TransformationClass");
- 
-    TransformationManager::registerTransformation(TransName, TransImpl);
+    TransformationManager::registerTransformation(TransName, Desc,
+      [=]() -> Transformation * {
+        Transformation *TransImpl =
+          new TransformationClass(TransName, Desc, args...);
+        assert(TransImpl && "Fail to create TransformationClass");
+        return TransImpl;
+      });
   }
 
 private:
@@ -0,0 +1,8 @@
+int a, b;
+struct S {
+  int x;
+  int y;
+};
+int foo(void) {
+  return a;
+}
@@ -0,0 +1,4 @@
+int foo(int a, int b) {
+  int x = a + b;
+  return x * a;
+}
@@ -0,0 +1,10 @@
+struct S {
+  int f1;
+  int f2;
+  int f3;
+};
+
+void foo() {
+  struct S s = {1, 2, 3};
+  s.f2 = 0;
+}
@@ -0,0 +1,15 @@
+int foo(int x) {
+  if (x)
+    return 1;
+  return 0;
+}
+
+int bar(int x);
+
+int bar(int x) {
+  if (x)
+    return 2;
+  if (x > 1)
+    return 3;
+  return 0;
+}
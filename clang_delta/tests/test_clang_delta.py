@@ -90,6 +90,9 @@ class TestClangDelta(unittest.TestCase):
     def test_copy_propagation_copy2(self):
         self.check_clang_delta('copy-propagation/copy2.cpp', '--transformation=copy-propagation --counter=2')
 
+    def test_emit_topforms_test1(self):
+        self.check_clang_delta('emit-topforms/test1.c', '--emit-topforms')
+
     def test_empty_struct_to_int_empty_struct(self):
         self.check_clang_delta('empty-struct-to-int/empty-struct.cpp', '--transformation=empty-struct-to-int --counter=1')
 
@@ -124,6 +127,19 @@ class TestClangDelta(unittest.TestCase):
     def test_empty_struct_to_int_test3(self):
         self.check_clang_delta('empty-struct-to-int/test3.c', '--transformation=empty-struct-to-int --counter=1')
 
+    def test_expression_detector_batch(self):
+        # the instances 5 and 6 are in instance 4
+        self.check_clang_delta('expression-detector/batch.c', '--transformation=expression-detector --counter=2 --to-counter=6')
+
+    def test_expression_detector_batch_paren(self):
+        self.check_clang_delta('expression-detector/batch.c', '--transformation=expression-detector --counter=5 --to-counter=6',
+                               output_file='expression-detector/batch.c.paren.output')
+
+    def test_expression_detector_batch_reference(self):
+        self.check_clang_delta('expression-detector/batch.c',
+                               '--transformation=expression-detector --counter=1 --to-counter=4 --check-reference=3',
+                               output_file='expression-detector/batch.c.reference.output')
+
     def test_instantiate_template_param_default_param(self):
         self.check_clang_delta('instantiate-template-param/default_param.cc', '--transformation=instantiate-template-param --counter=1')
 
@@ -303,6 +319,9 @@ class TestClangDelta(unittest.TestCase):
     def test_remove_unused_field_designated5(self):
         self.check_clang_delta('remove-unused-field/designated5.c', '--transformation=remove-unused-field --counter=2')
 
+    def test_remove_unused_field_record1(self):
+        self.check_clang_delta('remove-unused-field/record1.c', '--transformation=remove-unused-record-fields --counter=1')
+
     def test_remove_unused_field_unused_field1(self):
         self.check_clang_delta('remove-unused-field/unused_field1.c', '--transformation=remove-unused-field --counter=1')
 
@@ -565,6 +584,18 @@ class TestClangDelta(unittest.TestCase):
     def test_simplify_if_macro(self):
         self.check_clang_delta('simplify-if/macro.c', '--transformation=simplify-if --counter=1')
 
+    def test_simplify_if_region_range(self):
+        self.check_query_instances('simplify-if/region.c', '--query-instances=simplify-if --range=1:5',
+                                   'Available transformation instances: 1')
+
+    def test_simplify_if_region_decl(self):
+        self.check_query_instances('simplify-if/region.c', '--query-instances=simplify-if --decl=bar',
+                                   'Available transformation instances: 2')
+
+    def test_simplify_if_region_unsupported(self):
+        self.check_error_message('simplify-if/region.c', '--transformation=remove-unused-field --counter=1 --range=1:5',
+                                 'Error: current transformation[remove-unused-field] does not support --range or --decl!')
+
     def test_simplify_simple_recursive_template(self):
         self.check_clang_delta('simplify-recursive-template-instantiation/test.cc', '--transformation=simplify-recursive-template-instantiation --counter=1')
 
@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+
+import argparse
+import importlib.util
+import logging
+import os
+import sys
+
+# If the cvise modules cannot be found
+# add the known install location to the path
+destdir = os.getenv('DESTDIR', '')
+if importlib.util.find_spec('cvise') is None:
+    sys.path.append('@CMAKE_INSTALL_FULL_DATADIR@')
+    sys.path.append(destdir + '@CMAKE_INSTALL_FULL_DATADIR@')
+
+from cvise.utils.remote import DEFAULT_PORT, WorkerServer  # noqa: E402
+from cvise.utils.sandbox import get_tmp_dir  # noqa: E402
+import psutil  # noqa: E402
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='C-Vise worker daemon: runs the interestingness tests of '
+                                     'C-Vise instances started with --remote-workers')
+    parser.add_argument('--host', default='localhost', help='Address to listen on; the daemon runs the test scripts it gets, use it on trusted networks only')
+    parser.add_argument('--port', type=int, default=DEFAULT_PORT, help='Port to listen on')
+    parser.add_argument('--n', '-n', type=int, default=psutil.cpu_count(), help='Number of tests that run at the same time')
+    parser.add_argument('--tmpfs', action='store_true', help='Run the tests in a temporary directory in tmpfs')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(message)s')
+    server = WorkerServer((args.host, args.port), args.n, get_tmp_dir(args.tmpfs))
+    logging.info(f'running {args.n} tests at a time on {args.host}:{args.port} in {server.root}')
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        logging.info('Exiting now ...')
+    finally:
+        server.server_close()
@@ -26,6 +26,10 @@ from cvise.passes.abstract import AbstractPass  # noqa: E402
 from cvise.utils import misc, statistics, testing  # noqa: E402
 from cvise.utils.error import CViseError  # noqa: E402
 from cvise.utils.error import MissingPassGroupsError  # noqa: E402
+from cvise.utils.history import get_features, PassHistory  # noqa: E402
+from cvise.utils.portfolio import get_member_folder, get_share, Portfolio, rotate_passes, SnapshotExchange  # noqa: E402
+from cvise.utils.remote import get_jobs, parse_address  # noqa: E402
+from cvise.utils.sandbox import get_tmp_dir  # noqa: E402
 import psutil  # noqa: E402
 
 
@@ -102,6 +106,49 @@ def get_pass_group_path(name):
     return os.path.join(get_share_dir(), 'pass_groups', name + '.json')
 
 
+def get_parallel_tests(value):
+    if value == 'auto':
+        return value
+    try:
+        return int(value)
+    except ValueError:
+        raise argparse.ArgumentTypeError(f"invalid value: '{value}' (expected a number or 'auto')")
+
+
+def run_portfolio(args):
+    parallel_tests = get_available_cores() if args.n == 'auto' else args.n
+    portfolio = Portfolio(args.portfolio, args.test_cases, get_tmp_dir(args.tmpfs))
+    logging.info(f'running a portfolio of {args.portfolio} reducers in {portfolio.root}')
+
+    def get_command(member):
+        share = get_share(parallel_tests, member, args.portfolio)
+        return ([sys.executable, sys.argv[0]] + sys.argv[1:] +
+                ['--n', str(share), '--portfolio-member', str(member), '--portfolio-dir', portfolio.root])
+
+    if not args.tidy:
+        for test_case in args.test_cases:
+            if not os.path.exists(f'{test_case}.orig'):
+                shutil.copy2(test_case, f'{test_case}.orig')
+
+    returncodes = portfolio.run(get_command)
+    for member, returncode in enumerate(returncodes):
+        print(f'Portfolio member {member}: {portfolio.get_size(member)} bytes, exit code {returncode}')
+    best = portfolio.get_best([m for m, returncode in enumerate(returncodes) if returncode == 0])
+    if best is None:
+        print(f'All members of the portfolio failed, see the logs in {portfolio.root}')
+        return 1
+
+    portfolio.adopt(best)
+    portfolio.cleanup()
+    print('Reduced test-cases:\n')
+    for test_case in sorted(args.test_cases):
+        if misc.is_readable_file(test_case):
+            print(f'--- {test_case} ---')
+            with open(test_case) as test_case_file:
+                print(test_case_file.read())
+    return 0
+
+
 def get_available_pass_groups():
     pass_group_dir = os.path.join(get_share_dir(), 'pass_groups')
 
@@ -162,7 +209,17 @@ For bug reporting instructions, please use:
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='C-Vise', formatter_class=argparse.RawDescriptionHelpFormatter, epilog=EPILOG_TEXT)
-    parser.add_argument('--n', '-n', type=int, default=get_available_cores(), help='Number of cores to use; C-Vise tries to automatically pick a good setting but its choice may be too low or high for your situation')
+    parser.add_argument('--n', '-n', type=get_parallel_tests, default=get_available_cores(), help="Number of cores to use; C-Vise tries to automatically pick a good setting but its choice may be too low or high for your situation. With 'auto', the number of parallel tests is adapted during the run to the rate of finished tests, the memory usage and the pressure on the system")
+    parser.add_argument('--transformers', type=int, default=0, help='Number of processes that generate upcoming variants ahead of the interestingness tests; by default every test process transforms its own variant')
+    parser.add_argument('--parallel-files', metavar='N', type=int, default=1, help='Run a pass on up to N test cases at the same time; the variants of a test case are tested with the current versions of the other test cases, and a success is tested again if another test case changed meanwhile')
+    parser.add_argument('--adaptive-passes', action='store_true', help='Run the main passes in the order of their recent gain (bytes removed per CPU second) and retry passes that stopped removing anything only in every {}th round'.format(CVise.EXPLORATION_INTERVAL))
+    parser.add_argument('--pass-history', metavar='FILE', help='SQLite database with the outcomes of the passes in earlier reductions of similar inputs; they set the max-transforms limits of passes with a low gain and, with --adaptive-passes, the initial order of the main passes. The outcomes of this reduction are added')
+    parser.add_argument('--portfolio', metavar='K', type=int, help='Run K reducers on their own copies of the test cases, each with a different order of the main passes and its share of the --n test processes; between passes, every reducer adopts the smallest result of the others')
+    parser.add_argument('--portfolio-member', type=int, help=argparse.SUPPRESS)
+    parser.add_argument('--portfolio-dir', help=argparse.SUPPRESS)
+    parser.add_argument('--remote-workers', metavar='HOST:PORT[,HOST:PORT...]', help='Run the interestingness tests in cvise-worker daemons, as many at a time as the daemons run; the variants are transformed locally (see --transformers), only the files that changed are sent')
+    parser.add_argument('--test-server', action='store_true', help='Start the interestingness test once per test process and let it test all variants of the process: with CVISE_TEST_SERVER=1 in its environment, the test reads the path of a variant folder per line from stdin and writes the exit code for it as a line to stdout')
+    parser.add_argument('--no-speculation', action='store_true', help="Don't start the next pass on idle test workers while the last tests of a pass finish")
     parser.add_argument('--tidy', action='store_true', help='Do not make a backup copy of each file to reduce as file.orig')
     parser.add_argument('--shaddap', action='store_true', help='Suppress output about non-fatal internal errors')
     parser.add_argument('--die-on-pass-bug', action='store_true', help='Terminate C-Vise if a pass encounters an otherwise non-fatal problem')
@@ -174,14 +231,20 @@ if __name__ == '__main__':
     parser.add_argument('--no-give-up', action='store_true', help=f"Don't give up on a pass that hasn't made progress for {testing.TestManager.GIVEUP_CONSTANT} iterations")
     parser.add_argument('--print-diff', action='store_true', help='Show changes made by transformations, for debugging')
     parser.add_argument('--save-temps', action='store_true', help="Don't delete /tmp/cvise-xxxxxx directories on termination")
+    parser.add_argument('--cache-memory-limit', type=int, default=1024, help='Memory limit of the cache of pass results in MB; least recently used results are dropped (0 means no limit)')
+    parser.add_argument('--cache-dir', help='Directory of a persistent cache of interestingness test results, which is shared by restarted runs and concurrent C-Vise instances')
+    parser.add_argument('--checkpoint', help='Periodically save the progress of the reduction to this file')
+    parser.add_argument('--resume', help='Resume a reduction from a checkpoint (see --checkpoint); new checkpoints are written to the same file unless --checkpoint is given')
+    parser.add_argument('--tmpfs', action='store_true', help='Create the temporary test directories on tmpfs (/dev/shm) if available')
     parser.add_argument('--skip-initial-passes', action='store_true', help='Skip initial passes (useful if input is already partially reduced)')
     parser.add_argument('--skip-interestingness-test-check', '-s', action='store_true', help='Skip initial interestingness test check')
     parser.add_argument('--remove-pass', help='Remove all instances of the specified passes from the schedule (comma-separated)')
     parser.add_argument('--start-with-pass', help='Start with the specified pass')
     parser.add_argument('--no-timing', action='store_true', help='Do not print timestamps about reduction progress')
     parser.add_argument('--timestamp', action='store_true', help='Print timestamps instead of relative time from a reduction start')
-    parser.add_argument('--timeout', type=int, nargs='?', default=300, help='Interestingness test timeout in seconds')
-    parser.add_argument('--no-cache', action='store_true', help="Don't cache behavior of passes")
+    parser.add_argument('--timeout', type=int, nargs='?', default=testing.TestManager.DEFAULT_TIMEOUT, help='Interestingness test timeout in seconds')
+    parser.add_argument('--adaptive-timeout', action='store_true', help='Adapt the interestingness test timeout to the runtimes of the interesting variants, up to --timeout seconds')
+    parser.add_argument('--no-cache', action='store_true', help="Don't cache behavior of passes and results of the interestingness test")
     parser.add_argument('--skip-key-off', action='store_true', help="Disable skipping the rest of the current pass when 's' is pressed")
     parser.add_argument('--max-improvement', metavar='BYTES', type=int, help='Largest improvement in file size from a single transformation that C-Vise should accept (useful only to slow C-Vise down)')
     passes_group = parser.add_mutually_exclusive_group()
@@ -287,6 +350,16 @@ if __name__ == '__main__':
                     with open(test_case, 'w') as w:
                         w.write(data)
 
+    if args.remote_workers and (args.n == 'auto' or args.portfolio or args.test_server):
+        print('--remote-workers cannot be combined with --n=auto, --portfolio or --test-server')
+        sys.exit(1)
+
+    if args.portfolio and args.portfolio_member is None:
+        if args.checkpoint or args.resume:
+            print('--portfolio cannot be combined with --checkpoint or --resume')
+            sys.exit(1)
+        sys.exit(run_portfolio(args))
+
     script = None
     if args.commands:
         with tempfile.NamedTemporaryFile(mode='w', delete=False, suffix='.sh') as script:
@@ -296,35 +369,88 @@ if __name__ == '__main__':
         logging.info('Using temporary interestingness test: %s' % script.name)
         args.interestingness_test = script.name
 
+    exchange = None
+    if args.portfolio_member is not None:
+        # a member of a portfolio reduces its own copy of the test cases
+        args.interestingness_test = os.path.abspath(args.interestingness_test)
+        if args.cache_dir:
+            args.cache_dir = os.path.abspath(args.cache_dir)
+        if args.pass_history:
+            args.pass_history = os.path.abspath(args.pass_history)
+        os.chdir(get_member_folder(args.portfolio_dir, args.portfolio_member))
+        args.skip_key_off = True
+        args.tidy = True
+        pass_group['main'] = rotate_passes(pass_group['main'], args.portfolio_member, args.portfolio)
+        exchange = SnapshotExchange(args.portfolio_dir, args.portfolio_member)
+
+    pass_history = None
+    if args.pass_history:
+        pass_group_name = os.path.splitext(os.path.basename(pass_group_file))[0]
+        pass_history = PassHistory(args.pass_history, get_features(args.test_cases, pass_group_name))
+        pass_history.apply(pass_group['main'], pass_statistic, CVise.DORMANT_RUNS)
+
+    parallel_tests = get_available_cores() if args.n == 'auto' else args.n
+    transformers = args.transformers
+    remote_workers = None
+    if args.remote_workers:
+        remote_workers = []
+        for value in args.remote_workers.split(','):
+            try:
+                address = parse_address(value)
+                remote_workers.append((address, get_jobs(address)))
+            except (ValueError, OSError) as e:
+                print(f"Cannot connect to the remote worker '{value}': {e}")
+                sys.exit(1)
+        parallel_tests = sum(jobs for _, jobs in remote_workers)
+        transformers = transformers or get_available_cores()
+        logging.info(f'running the tests in {len(remote_workers)} remote workers')
     test_manager = testing.TestManager(pass_statistic, args.interestingness_test, args.timeout,
-                                       args.save_temps, args.test_cases, args.n, args.no_cache, args.skip_key_off, args.shaddap,
+                                       args.save_temps, args.test_cases, parallel_tests, args.no_cache, args.skip_key_off, args.shaddap,
                                        args.die_on_pass_bug, args.print_diff, args.max_improvement, args.no_give_up, args.also_interesting,
-                                       args.start_with_pass, args.skip_after_n_transforms)
+                                       args.start_with_pass, args.skip_after_n_transforms, tmpfs=args.tmpfs,
+                                       transformers=transformers, cache_dir=args.cache_dir,
+                                       checkpoint=args.checkpoint,
+                                       cache_memory_limit=args.cache_memory_limit * 1024 * 1024 or None,
+                                       auto_parallel=args.n == 'auto', exchange=exchange,
+                                       speculate=not args.no_speculation, parallel_files=args.parallel_files,
+                                       remote_workers=remote_workers, test_server=args.test_server,
+                                       adaptive_timeout=args.adaptive_timeout)
 
     reducer = CVise(test_manager, args.skip_interestingness_test_check)
 
     reducer.tidy = args.tidy
+    reducer.adaptive_passes = args.adaptive_passes
 
     # Track runtime
     time_start = time.monotonic()
 
     try:
-        reducer.reduce(pass_group, skip_initial=args.skip_initial_passes)
+        if args.resume:
+            test_manager.resume(args.resume)
+        reducer.reduce(pass_group, skip_initial=args.skip_initial_passes, resume=bool(args.resume))
     except CViseError as err:
         time_stop = time.monotonic()
         print(err)
     else:
         time_stop = time.monotonic()
+        if pass_history:
+            pass_history.add(pass_statistic)
         print('===< PASS statistics >===')
-        print('  %-60s %8s %8s %8s %8s %15s' % ('pass name', 'time (s)', 'time (%)', 'worked',
-              'failed', 'total executed'))
+        print('  %-60s %8s %8s %8s %8s %8s %15s' % ('pass name', 'time (s)', 'time (%)', 'worked',
+              'failed', 'timeouts', 'total executed'))
 
         for pass_name, pass_data in pass_statistic.sorted_results:
-            print('  %-60s %8.2f %8.2f %8d %8d %15d' % (pass_name, pass_data.total_seconds,
+            print('  %-60s %8.2f %8.2f %8d %8d %8d %15d' % (pass_name, pass_data.total_seconds,
                   100.0 * pass_data.total_seconds / (time_stop - time_start),
-                pass_data.worked, pass_data.failed, pass_data.totally_executed))
+                pass_data.worked, pass_data.failed, pass_data.timeouts, pass_data.totally_executed))
         print()
 
+        if not args.no_cache:
+            test_cache = test_manager.test_cache
+            print(f'Test result cache: {test_cache.hits} hits of {test_cache.hits + test_cache.misses} ({round(test_cache.hit_rate, 1)}%), '
+                  f'saved {round(test_cache.saved_seconds, 1)} test seconds')
+            print()
+
         if not args.no_timing:
             print(f'Runtime: {round((time_stop - time_start))} seconds')
 
@@ -336,5 +462,7 @@ if __name__ == '__main__':
                     print(test_case_file.read())
         if script:
             os.unlink(script.name)
+    finally:
+        test_manager.close()
 
     logging.shutdown()
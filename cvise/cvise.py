@@ -1,5 +1,6 @@
 import json
 import logging
+import math
 import os
 
 from cvise.passes.abstract import AbstractPass
@@ -7,6 +8,7 @@ from cvise.passes.balanced import BalancedPass
 from cvise.passes.blank import BlankPass
 from cvise.passes.clang import ClangPass
 from cvise.passes.clangbinarysearch import ClangBinarySearchPass
+from cvise.passes.clangtopforms import ClangTopFormsPass
 from cvise.passes.clex import ClexPass
 from cvise.passes.comments import CommentsPass
 from cvise.passes.gcdabinary import GCDABinaryPass
@@ -41,6 +43,7 @@ class CVise:
         'blank': BlankPass,
         'clang': ClangPass,
         'clangbinarysearch': ClangBinarySearchPass,
+        'clangtopforms': ClangTopFormsPass,
         'clex': ClexPass,
         'comments': CommentsPass,
         'gcda-binary': GCDABinaryPass,
@@ -57,10 +60,18 @@ class CVise:
         'unifdef': UnIfDefPass,
     }
 
+    CATEGORIES = ['first', 'main', 'last']
+    # with adaptive_passes, passes that removed nothing in their last DORMANT_RUNS runs
+    # only run in every EXPLORATION_INTERVAL-th round of the main passes
+    DORMANT_RUNS = 2
+    EXPLORATION_INTERVAL = 4
+
     def __init__(self, test_manager, skip_interestingness_test_check):
         self.test_manager = test_manager
         self.skip_interestingness_test_check = skip_interestingness_test_check
         self.tidy = False
+        self.adaptive_passes = False
+        self.resume_position = None
 
     @classmethod
     def load_pass_group_file(cls, path):
@@ -132,27 +143,33 @@ class CVise:
 
         return pass_group
 
-    def reduce(self, pass_group, skip_initial):
+    def reduce(self, pass_group, skip_initial, resume=False):
         self._check_prerequisites(pass_group)
-        if not self.skip_interestingness_test_check:
+        if resume:
+            # the interrupted run did the sanity check and the backup
+            checkpoint = self.test_manager.checkpoint
+            self.resume_position = (self.CATEGORIES.index(checkpoint.category), checkpoint.pass_index)
+        elif not self.skip_interestingness_test_check:
             self.test_manager.check_sanity(True)
 
         logging.info(f'===< {os.getpid()} >===')
-        logging.info('running {} interestingness test{} in parallel'.format(self.test_manager.parallel_tests,
-                                                                            '' if self.test_manager.parallel_tests == 1 else 's'))
+        logging.info('running {} interestingness test{} in parallel{}'.format(self.test_manager.parallel_tests,
+                                                                              '' if self.test_manager.parallel_tests == 1 else 's',
+                                                                              ' (adapted to the load)' if self.test_manager.parallelism else ''))
 
-        if not self.tidy:
+        if not self.tidy and not resume:
             self.test_manager.backup_test_cases()
 
-        if not skip_initial:
+        if not skip_initial and not self._is_resumed_after('first'):
             logging.info('INITIAL PASSES')
-            self._run_additional_passes(pass_group['first'])
+            self._run_additional_passes('first', pass_group['first'])
 
-        logging.info('MAIN PASSES')
-        self._run_main_passes(pass_group['main'])
+        if not self._is_resumed_after('main'):
+            logging.info('MAIN PASSES')
+            self._run_main_passes(pass_group['main'])
 
         logging.info('CLEANUP PASSES')
-        self._run_additional_passes(pass_group['last'])
+        self._run_additional_passes('last', pass_group['last'])
 
         logging.info('===================== done ====================')
         return True
@@ -164,24 +181,71 @@ class CVise:
                 if not p.check_prerequisites():
                     logging.error(f'Prereqs not found for pass {p}')
 
-    def _run_additional_passes(self, passes):
-        for p in passes:
+    # A resumed run skips the passes before the position of the checkpoint
+    def _is_resumed_after(self, category):
+        return self.resume_position is not None and self.resume_position[0] > self.CATEGORIES.index(category)
+
+    def _skip_pass(self, category, index):
+        if self.resume_position is None:
+            return False
+        if (self.CATEGORIES.index(category), index) < self.resume_position:
+            return True
+        self.resume_position = None
+        return False
+
+    def _run_additional_passes(self, category, passes):
+        for i, p in enumerate(passes):
+            if self._skip_pass(category, i):
+                continue
             if not p.check_prerequisites():
                 logging.error(f'Skipping {p}')
             else:
-                self.test_manager.run_pass(p)
+                self.test_manager.set_position(category, i)
+                self.test_manager.run_pass(p, passes[i + 1] if i + 1 < len(passes) else None)
+
+    # Indices of the main passes of a round. Adaptive rounds run the passes in the order
+    # of their gain (bytes removed per CPU second), passes that never ran first.
+    def _get_round_order(self, passes, round_index, all_passes):
+        order = list(range(len(passes)))
+        if not self.adaptive_passes:
+            return order
+        stats = [self.test_manager.pass_statistic.stats.get(repr(p)) for p in passes]
+        if not all_passes and round_index % self.EXPLORATION_INTERVAL:
+            order = [i for i in order if not stats[i] or stats[i].idle_runs < self.DORMANT_RUNS]
+        return sorted(order, key=lambda i: -math.inf if not stats[i] or stats[i].gain is None else -stats[i].gain)
 
     def _run_main_passes(self, passes):
+        checkpoint = self.test_manager.checkpoint
+        main_sizes = checkpoint.main_sizes
+        all_passes = False
         while True:
-            total_file_size = self.test_manager.total_file_size
+            if self.resume_position is not None:
+                # continue the round of the checkpoint
+                total_file_size = main_sizes[-1]
+            else:
+                total_file_size = self.test_manager.total_file_size
+                main_sizes.append(total_file_size)
+                checkpoint.main_order = self._get_round_order(passes, len(main_sizes), all_passes)
 
-            for p in passes:
+            order = checkpoint.main_order
+            for position, i in enumerate(order):
+                if self._skip_pass('main', position):
+                    continue
+                p = passes[i]
                 if not p.check_prerequisites():
                     logging.error(f'Skipping pass {p}')
                 else:
-                    self.test_manager.run_pass(p)
+                    self.test_manager.set_position('main', position)
+                    next_pass = passes[order[position + 1]] if position + 1 < len(order) else None
+                    self.test_manager.run_pass(p, next_pass)
 
             logging.info(f'Termination check: size was {total_file_size}; now {self.test_manager.total_file_size}')
 
             if self.test_manager.total_file_size >= total_file_size:
-                break
+                # the reduction only ends after a round of all passes
+                if len(checkpoint.main_order) == len(passes):
+                    break
+                logging.info('no progress without the dormant passes, running all passes')
+                all_passes = True
+            else:
+                all_passes = False
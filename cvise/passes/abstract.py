@@ -4,6 +4,8 @@ import logging
 import shutil
 import subprocess
 
+from cvise.utils.process import kill_process_group
+
 
 @unique
 class PassResult(Enum):
@@ -68,6 +70,10 @@ class AbstractPass:
         slow = 'slow'
         windows = 'windows'
 
+    # Concurrent successful variants of the pass can be merged: its edits are
+    # positional and independent of each other
+    supports_merge = False
+
     def __init__(self, arg=None, external_programs=None):
         self.external_programs = external_programs
         self.arg = arg
@@ -107,29 +113,27 @@ class AbstractPass:
         raise NotImplementedError(f"Class {type(self).__name__} has not implemented 'transform'!")
 
 
-@unique
-class ProcessEventType(Enum):
-    STARTED = auto()
-    FINISHED = auto()
-
-
-class ProcessEvent:
-    def __init__(self, pid, event_type):
-        self.pid = pid
-        self.type = event_type
-
-
+# Every process runs in a new process group, which is killed once the process
+# finishes. The optional ProcessGroups record the groups of running processes.
 class ProcessEventNotifier:
-    def __init__(self, pid_queue):
-        self.pid_queue = pid_queue
+    def __init__(self, process_groups):
+        self.process_groups = process_groups
+
+    def start_process(self, cmd, stdout, stderr, shell):
+        proc = subprocess.Popen(cmd, stdout=stdout, stderr=stderr, universal_newlines=True, encoding='utf8', shell=shell,
+                                start_new_session=True)
+        if self.process_groups:
+            self.process_groups.add(proc.pid)
+        return proc
 
     def run_process(self, cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, shell=False):
         if shell:
             assert isinstance(cmd, str)
-        proc = subprocess.Popen(cmd, stdout=stdout, stderr=stderr, universal_newlines=True, encoding='utf8', shell=shell)
-        if self.pid_queue:
-            self.pid_queue.put(ProcessEvent(proc.pid, ProcessEventType.STARTED))
-        stdout, stderr = proc.communicate()
-        if self.pid_queue:
-            self.pid_queue.put(ProcessEvent(proc.pid, ProcessEventType.FINISHED))
+        proc = self.start_process(cmd, stdout, stderr, shell)
+        try:
+            stdout, stderr = proc.communicate()
+        finally:
+            kill_process_group(proc.pid)
+            if self.process_groups:
+                self.process_groups.remove(proc.pid)
         return (stdout, stderr, proc.returncode)
@@ -4,6 +4,8 @@ from cvise.utils.error import UnknownArgumentError
 
 
 class BalancedPass(AbstractPass):
+    supports_merge = True
+
     def check_prerequisites(self):
         return True
 
@@ -0,0 +1,87 @@
+import logging
+import os
+import shutil
+import subprocess
+import tempfile
+
+from cvise.passes.abstract import AbstractPass, BinaryState, PassResult
+
+
+# Remove whole declarations, using the byte ranges reported by clang_delta --emit-topforms
+class ClangTopFormsPass(AbstractPass):
+    QUERY_TIMEOUT = 10
+
+    def check_prerequisites(self):
+        return self.check_external_program('clang_delta')
+
+    def get_topforms(self, test_case):
+        args = [self.external_programs['clang_delta'], '--emit-topforms']
+        if self.user_clang_delta_std:
+            args.append(f'--std={self.user_clang_delta_std}')
+        cmd = args + [test_case]
+
+        try:
+            proc = subprocess.run(cmd, universal_newlines=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                  timeout=self.QUERY_TIMEOUT)
+        except subprocess.TimeoutExpired:
+            logging.warning(f'clang_delta --emit-topforms {self.QUERY_TIMEOUT}s timeout reached')
+            return []
+        except subprocess.SubprocessError as e:
+            logging.warning(f'clang_delta --emit-topforms failed: {e}')
+            return []
+
+        if proc.returncode != 0:
+            logging.warning(f'clang_delta --emit-topforms failed with exit code {proc.returncode}: {proc.stderr.strip()}')
+            return []
+
+        topforms = []
+        for line in proc.stdout.splitlines():
+            begin, end = line.split()
+            topforms.append((int(begin), int(end)))
+        return topforms
+
+    @staticmethod
+    def merge_ranges(ranges):
+        # nested and overlapping ranges (e.g. a record and its members) are merged
+        merged = []
+        for begin, end in sorted(ranges):
+            if merged and begin <= merged[-1][1]:
+                merged[-1][1] = max(merged[-1][1], end)
+            else:
+                merged.append([begin, end])
+        return merged
+
+    def create_state(self, test_case):
+        topforms = self.get_topforms(test_case)
+        state = BinaryState.create(len(topforms))
+        if state:
+            state.topforms = topforms
+        return state
+
+    def new(self, test_case, _=None):
+        return self.create_state(test_case)
+
+    def advance(self, test_case, state):
+        return state.advance()
+
+    def advance_on_success(self, test_case, state):
+        topforms = self.get_topforms(test_case)
+        state = state.advance_on_success(len(topforms))
+        if state:
+            state.topforms = topforms
+        return state
+
+    def transform(self, test_case, state, process_event_notifier):
+        with open(test_case, 'rb') as in_file:
+            data = in_file.read()
+
+        for begin, end in reversed(self.merge_ranges(state.topforms[state.index:state.end()])):
+            data = data[:begin] + data[end:]
+
+        tmp = os.path.dirname(test_case)
+        with tempfile.NamedTemporaryFile(mode='wb', delete=False, dir=tmp) as tmp_file:
+            tmp_file.write(data)
+
+        shutil.move(tmp_file.name, test_case)
+
+        return (PassResult.OK, state)
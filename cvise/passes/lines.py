@@ -6,41 +6,39 @@ import tempfile
 
 from cvise.passes.abstract import AbstractPass, BinaryState, PassResult
 from cvise.utils.error import InsaneTestCaseError
+from cvise.utils.misc import replace_file
 
 
 class LinesPass(AbstractPass):
+    supports_merge = True
+
     def check_prerequisites(self):
         return self.check_external_program('topformflat')
 
     def __format(self, test_case, check_sanity):
-        tmp = os.path.dirname(test_case)
-
-        with tempfile.NamedTemporaryFile(mode='w+', dir=tmp) as backup, tempfile.NamedTemporaryFile(mode='w+', dir=tmp) as tmp_file:
-            with open(test_case) as in_file:
-                try:
-                    cmd = [self.external_programs['topformflat'], self.arg]
-                    proc = subprocess.run(cmd, stdin=in_file, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
-                except subprocess.SubprocessError:
-                    return
-
-            for line in proc.stdout.splitlines(keepends=True):
-                if not line.isspace():
-                    tmp_file.write(line)
-            tmp_file.flush()
-
-            # we need to check that sanity check is still fine
-            if check_sanity:
-                shutil.copy(test_case, backup.name)
-                shutil.copy(tmp_file.name, test_case)
-                try:
-                    check_sanity()
-                except InsaneTestCaseError:
-                    shutil.copy(backup.name, test_case)
-                    # if we are not the first lines pass, we should bail out
-                    if self.arg != '0':
-                        self.bailout = True
-            else:
-                shutil.copy(tmp_file.name, test_case)
+        with open(test_case) as in_file:
+            try:
+                cmd = [self.external_programs['topformflat'], self.arg]
+                proc = subprocess.run(cmd, stdin=in_file, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+            except subprocess.SubprocessError:
+                return
+            encoding = in_file.encoding
+
+        formatted = ''.join(line for line in proc.stdout.splitlines(keepends=True) if not line.isspace())
+        with open(test_case, 'rb') as f:
+            original = f.read()
+
+        # the test case gets a new file, tests of the other test cases may still read it
+        replace_file(test_case, formatted.encode(encoding))
+        # we need to check that sanity check is still fine
+        if check_sanity:
+            try:
+                check_sanity()
+            except InsaneTestCaseError:
+                replace_file(test_case, original)
+                # if we are not the first lines pass, we should bail out
+                if self.arg != '0':
+                    self.bailout = True
 
     def __count_instances(self, test_case):
         with open(test_case) as in_file:
@@ -6,6 +6,7 @@ from cvise.utils.error import UnknownArgumentError
 
 
 class PeepPass(AbstractPass):
+    supports_merge = True
     border = r'[*{([:,})\];]'
     border_or_space = r'(?:(?:' + border + r')|\s)'
     border_or_space_optional = r'(?:(?:' + border + r')|\s)?'
@@ -0,0 +1,87 @@
+import os
+import tempfile
+import unittest
+
+from cvise.utils.cache import hash_context, hash_data, hash_variant, PassCache, ResultCache, ResultStore
+
+
+class CacheTestCase(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.TemporaryDirectory()
+        self.test_case = self.write('test.c', 'int a;\n')
+        self.header = self.write('test.h', 'int b;\n')
+
+    def tearDown(self):
+        self.folder.cleanup()
+
+    def write(self, name, content):
+        path = os.path.join(self.folder.name, name)
+        with open(path, 'w') as f:
+            f.write(content)
+        return path
+
+    def test_hash_variant(self):
+        context = hash_context(self.test_case, [self.header])
+        digest = hash_variant(context, self.test_case)
+        self.assertEqual(hash_variant(hash_context(self.test_case, [self.header]), self.test_case), digest)
+
+        # the files that are not transformed are part of the key
+        self.write('test.h', 'int c;\n')
+        self.assertNotEqual(hash_variant(hash_context(self.test_case, [self.header]), self.test_case), digest)
+        self.assertNotEqual(hash_variant(hash_context(self.test_case, []), self.test_case), digest)
+
+        self.write('test.h', 'int b;\n')
+        self.write('test.c', 'int d;\n')
+        self.assertNotEqual(hash_variant(context, self.test_case), digest)
+
+    def test_statistics(self):
+        cache = ResultCache()
+        cache.add(b'a', 1, 2.0)
+        cache.add(b'b', 0, 3.0)
+        cache.add_hit(b'a')
+        cache.add_hit(b'a')
+        self.assertEqual(cache.hits, 2)
+        self.assertEqual(cache.saved_seconds, 4.0)
+        self.assertEqual(cache.hit_rate, 50.0)
+        self.assertEqual(cache.get_returncodes(), {b'a': 1, b'b': 0})
+        self.assertEqual(cache.get_returncodes([b'b']), {b'b': 0})
+
+    def test_store(self):
+        cache_dir = os.path.join(self.folder.name, 'cache')
+        script = self.write('test.sh', 'exit 0\n')
+        # e.g. two concurrent instances
+        first = ResultCache(ResultStore(cache_dir, script))
+        second = ResultCache(ResultStore(cache_dir, script))
+        first.add(b'a', 1, 2.0)
+        self.assertEqual(first.sync(), [])
+        self.assertEqual(second.sync(), [b'a'])
+        self.assertEqual(second.results, {b'a': (1, 2.0)})
+        self.assertEqual(second.sync(), [])
+
+        # a restarted run with a changed interestingness test
+        self.write('test.sh', 'exit 1\n')
+        other = ResultCache(ResultStore(cache_dir, script))
+        self.assertEqual(other.sync(), [])
+
+    def test_pass_cache(self):
+        cache = PassCache()
+        before = b'int a; int b;'
+        cache.add('pass', hash_data(before), b'int a;')
+        self.assertEqual(cache.get('pass', hash_data(before), before), b'int a;')
+        self.assertIsNone(cache.get('other', hash_data(before), before))
+
+        # unchanged content is not stored again
+        cache.add('other', hash_data(before), before)
+        self.assertIs(cache.get('other', hash_data(before), before), before)
+
+    def test_pass_cache_limit(self):
+        cache = PassCache(3 * PassCache.ENTRY_SIZE)
+        for data in (b'a', b'b', b'c'):
+            cache.add('pass', hash_data(data), data)
+        self.assertEqual(len(cache.entries), 3)
+        # the least recently used entry is evicted
+        cache.get('pass', hash_data(b'a'), b'a')
+        cache.add('pass', hash_data(b'd'), b'x' * 100)
+        self.assertIsNotNone(cache.get('pass', hash_data(b'a'), b'a'))
+        self.assertIsNone(cache.get('pass', hash_data(b'b'), b'b'))
+        self.assertLessEqual(cache.size, 3 * PassCache.ENTRY_SIZE)
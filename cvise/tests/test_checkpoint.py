@@ -0,0 +1,44 @@
+import os
+import tempfile
+import unittest
+
+from cvise.passes.abstract import BinaryState
+from cvise.passes.balanced import BalancedPass
+from cvise.utils.checkpoint import Checkpoint, PassProgress
+from cvise.utils.error import InvalidCheckpointError
+
+
+class CheckpointTestCase(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.folder.name, 'checkpoint')
+
+    def tearDown(self):
+        self.folder.cleanup()
+
+    def test_write_read(self):
+        checkpoint = Checkpoint()
+        checkpoint.category = 'main'
+        checkpoint.pass_index = 2
+        checkpoint.main_sizes = [100, 80]
+        state = BinaryState.create(10).advance()
+        pass_ = BalancedPass('curly')
+        pass_.max_transforms = None
+        checkpoint.pass_progress = PassProgress(pass_, ['/a.c'], 0, 100, 3, b'int a;', state)
+        checkpoint.test_cases = {'/a.c': b'int a;'}
+        checkpoint.write(self.path)
+        checkpoint.write(self.path)
+        self.assertEqual(os.listdir(self.folder.name), ['checkpoint'])
+
+        checkpoint = Checkpoint.read(self.path)
+        self.assertEqual((checkpoint.category, checkpoint.pass_index), ('main', 2))
+        self.assertEqual(checkpoint.main_sizes, [100, 80])
+        self.assertEqual(repr(checkpoint.pass_progress.pass_), 'BalancedPass::curly')
+        self.assertEqual(checkpoint.pass_progress.state.index, state.index)
+        self.assertEqual(checkpoint.test_cases, {'/a.c': b'int a;'})
+
+    def test_invalid(self):
+        self.assertRaises(InvalidCheckpointError, Checkpoint.read, self.path)
+        with open(self.path, 'w') as f:
+            f.write('garbage')
+        self.assertRaises(InvalidCheckpointError, Checkpoint.read, self.path)
@@ -0,0 +1,46 @@
+import os
+import tempfile
+import unittest
+
+from cvise.passes.abstract import BinaryState
+from cvise.passes.clangtopforms import ClangTopFormsPass
+
+
+class ClangTopFormsTestCase(unittest.TestCase):
+    def setUp(self):
+        self.pass_ = ClangTopFormsPass()
+
+    def transform(self, data, topforms, index, chunk):
+        with tempfile.NamedTemporaryFile(mode='w', delete=False) as tmp_file:
+            tmp_file.write(data)
+
+        state = BinaryState.create(len(topforms))
+        state.topforms = topforms
+        state.index = index
+        state.chunk = chunk
+        self.pass_.transform(tmp_file.name, state, None)
+
+        with open(tmp_file.name) as variant_file:
+            variant = variant_file.read()
+
+        os.unlink(tmp_file.name)
+        return variant
+
+    def test_merge_ranges(self):
+        self.assertEqual(self.pass_.merge_ranges([(10, 41), (23, 29), (0, 9), (32, 38)]), [[0, 9], [10, 41]])
+        self.assertEqual(self.pass_.merge_ranges([(0, 5), (5, 9)]), [[0, 9]])
+
+    def test_remove_one(self):
+        data = 'int a;\nint b;\nint c;\n'
+        variant = self.transform(data, [(0, 6), (7, 13), (14, 20)], 1, 1)
+        self.assertEqual(variant, 'int a;\n\nint c;\n')
+
+    def test_remove_member(self):
+        data = 'struct S {\n  int x;\n  int y;\n};\n'
+        variant = self.transform(data, [(0, 31), (13, 19), (22, 28)], 2, 1)
+        self.assertEqual(variant, 'struct S {\n  int x;\n  \n};\n')
+
+    def test_remove_nested(self):
+        data = 'int a;\nstruct S {\n  int x;\n};\n'
+        variant = self.transform(data, [(0, 6), (7, 29), (20, 26)], 1, 2)
+        self.assertEqual(variant, 'int a;\n\n')
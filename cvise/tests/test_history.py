@@ -0,0 +1,83 @@
+import os
+import tempfile
+import unittest
+
+from cvise.passes.balanced import BalancedPass
+from cvise.passes.lines import LinesPass
+from cvise.utils.history import get_features, PassHistory
+from cvise.utils.statistics import PassStatistic
+
+
+class PassHistoryTestCase(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.folder.name, 'history.sqlite')
+        self.features = ('.c', 5, 'all')
+
+    def tearDown(self):
+        self.folder.cleanup()
+
+    @staticmethod
+    def get_passes():
+        passes = [LinesPass('0'), BalancedPass('curly')]
+        for p in passes:
+            p.max_transforms = None
+        return passes
+
+    def add_runs(self, features, lines_removed, balanced_removed):
+        statistic = PassStatistic()
+        lines, balanced = self.get_passes()
+        for _ in range(3):
+            statistic.get(lines).add_run(lines_removed, 1)
+            statistic.get(balanced).add_run(balanced_removed, 1)
+        statistic.get(lines).worked = 30
+        statistic.get(balanced).worked = 30
+        PassHistory(self.path, features).add(statistic)
+
+    def test_features(self):
+        path = os.path.join(self.folder.name, 'test.C')
+        with open(path, 'w') as f:
+            f.write('int a;\n')
+        self.assertEqual(get_features([path], 'all'), ('.c', 1, 'all'))
+
+    def test_priors(self):
+        self.add_runs(self.features, 1000, 0)
+        self.add_runs(self.features, 1000, 10)
+        passes = self.get_passes()
+        statistic = PassStatistic()
+        history = PassHistory(self.path, self.features)
+        history.apply(passes, statistic, 2)
+        lines, balanced = passes
+        self.assertIsNone(lines.max_transforms)
+        # ten transformations per run
+        self.assertEqual(balanced.max_transforms, 20)
+        self.assertEqual(statistic.get(lines).gain, 1000)
+        self.assertEqual(statistic.get(lines).idle_runs, 0)
+        # removed something in half of its runs
+        self.assertEqual(statistic.get(balanced).gain, 5)
+        self.assertEqual(statistic.get(balanced).idle_runs, 0)
+
+        # the outcomes of this run are added under the name without the limit
+        statistic.get(balanced).add_run(0, 1)
+        history.add(statistic)
+        self.assertEqual(history.load()['BalancedPass::curly'].runs, 7)
+
+    def test_dormant(self):
+        self.add_runs(self.features, 1000, 0)
+        passes = self.get_passes()
+        statistic = PassStatistic()
+        PassHistory(self.path, self.features).apply(passes, statistic, 2)
+        self.assertEqual(statistic.get(passes[1]).idle_runs, 2)
+
+    def test_size_classes(self):
+        self.add_runs(('.c', 4, 'all'), 1000, 0)
+        self.add_runs(('.c', 6, 'all'), 1000, 0)
+        self.add_runs(('.cpp', 5, 'all'), 0, 0)
+        records = PassHistory(self.path, self.features).load()
+        self.assertEqual(records['LinesPass::0'].runs, 6)
+
+        # the size class of the input wins once the passes ran often enough on it
+        self.add_runs(self.features, 0, 0)
+        records = PassHistory(self.path, self.features).load()
+        self.assertEqual(records['LinesPass::0'].runs, 3)
+        self.assertEqual(records['LinesPass::0'].removed_bytes, 0)
@@ -0,0 +1,44 @@
+import unittest
+
+from cvise.passes.balanced import BalancedPass
+from cvise.passes.clang import ClangPass
+from cvise.passes.lines import LinesPass
+from cvise.passes.peep import PeepPass
+from cvise.utils.merge import apply_edits, edits_overlap, get_edit, merge_variants
+
+
+class MergeTestCase(unittest.TestCase):
+    def test_get_edit(self):
+        self.assertEqual(get_edit(b'abcdef', b'abef'), (2, 4, b''))
+        self.assertEqual(get_edit(b'abcdef', b'abXYef'), (2, 4, b'XY'))
+        self.assertEqual(get_edit(b'abc', b'abc'), None)
+        self.assertEqual(get_edit(b'aaaa', b'aa'), (2, 4, b''))
+
+    def test_overlap(self):
+        self.assertFalse(edits_overlap((0, 2, b''), (3, 4, b'')))
+        self.assertFalse(edits_overlap((0, 2, b''), (2, 4, b'')))
+        self.assertTrue(edits_overlap((0, 3, b''), (2, 4, b'')))
+        self.assertTrue(edits_overlap((2, 2, b'x'), (0, 2, b'')))
+        self.assertFalse(edits_overlap((5, 6, b''), (0, 2, b'')))
+
+    def test_apply_edits(self):
+        self.assertEqual(apply_edits(b'abcdef', [(0, 1, b''), (3, 4, b'X')]), b'bcXef')
+
+    def test_merge_lines(self):
+        original = b'line1\nline2\nline3\nline4\n'
+        variants = [b'line1\nline3\nline4\n', b'line1\nline2\nline3\n', b'line1\nline4\n']
+        self.assertEqual(merge_variants(original, variants), (b'line1\nline3\n', 2))
+
+    def test_merge_adjacent(self):
+        original = b'a;b;c;'
+        self.assertEqual(merge_variants(original, [b'b;c;', b'a;c;']), (b'c;', 2))
+
+    def test_merge_first_wins(self):
+        original = b'int a = 1;'
+        self.assertEqual(merge_variants(original, [b'int a = 0;', b'int a = 2;']), (b'int a = 0;', 1))
+
+    def test_supports_merge(self):
+        # only passes with positional, independent edits merge their successes
+        for pass_ in (LinesPass, BalancedPass, PeepPass):
+            self.assertTrue(pass_.supports_merge)
+        self.assertFalse(ClangPass.supports_merge)
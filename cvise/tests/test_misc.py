@@ -0,0 +1,42 @@
+import os
+import stat
+import tempfile
+import unittest
+
+from cvise.utils.misc import count_lines, get_line_delta, replace_file
+
+
+class LineCountTestCase(unittest.TestCase):
+    def test_count_lines(self):
+        self.assertEqual(count_lines(b''), 0)
+        self.assertEqual(count_lines(b'a\n\n  \nb'), 2)
+        self.assertEqual(count_lines(b'a\r\nb\rc\n'), 3)
+
+    def test_line_delta(self):
+        old = b'int a;\nint b;\n\nint c;\n'
+        for new in (b'int a;\nint c;\n', b'int a;\n\n\nint c;\n', b'int a; int b;\n\nint c;\n',
+                    b'int a;\nint b;\nint x;\n\nint c;\n', b'', old):
+            self.assertEqual(get_line_delta(old, new), count_lines(new) - count_lines(old))
+
+    def test_line_delta_crlf(self):
+        old = b'a\r\nb\r\nc\r\n'
+        for new in (b'a\r\nc\r\n', b'a\rb\r\nc\r\n', b'a\r\n\r\nc\r\n', b'a\r\nb\nx\r\nc\r\n'):
+            self.assertEqual(get_line_delta(old, new), count_lines(new) - count_lines(old))
+
+
+class ReplaceFileTestCase(unittest.TestCase):
+    def test_replace(self):
+        with tempfile.TemporaryDirectory() as folder:
+            path = os.path.join(folder, 'test.c')
+            link = os.path.join(folder, 'link.c')
+            with open(path, 'wb') as f:
+                f.write(b'int a;\n')
+            os.chmod(path, 0o750)
+            os.link(path, link)
+            replace_file(path, b'int b;\n')
+            with open(path, 'rb') as f:
+                self.assertEqual(f.read(), b'int b;\n')
+            with open(link, 'rb') as f:
+                self.assertEqual(f.read(), b'int a;\n')
+            self.assertEqual(stat.S_IMODE(os.stat(path).st_mode), 0o750)
+            self.assertEqual(sorted(os.listdir(folder)), ['link.c', 'test.c'])
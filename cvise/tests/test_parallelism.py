@@ -0,0 +1,70 @@
+import unittest
+from unittest import mock
+
+from cvise.utils import parallelism
+from cvise.utils.parallelism import AutoParallelism
+
+
+class AutoParallelismTestCase(unittest.TestCase):
+    def setUp(self):
+        self.now = 0
+        self.pressure = {}
+        patches = [mock.patch('time.monotonic', lambda: self.now),
+                   mock.patch.object(parallelism, 'read_pressure', lambda resource: self.pressure.get(resource))]
+        for patch in patches:
+            patch.start()
+            self.addCleanup(patch.stop)
+
+    def run_interval(self, tuner, finished, test_memory=None):
+        for _ in range(finished):
+            tuner.add_finished()
+        self.now += AutoParallelism.INTERVAL
+        return tuner.update(lambda: test_memory)
+
+    def test_interval(self):
+        tuner = AutoParallelism(4)
+        tuner.add_finished()
+        self.now += AutoParallelism.INTERVAL / 2
+        self.assertFalse(tuner.update(lambda: None))
+        self.assertEqual(tuner.value, 4)
+
+    def test_hill_climbing(self):
+        tuner = AutoParallelism(4)
+        self.assertTrue(self.run_interval(tuner, 40))
+        self.assertEqual(tuner.value, 5)
+        self.run_interval(tuner, 50)
+        self.assertEqual(tuner.value, 6)
+        # the rate does not improve any more
+        self.run_interval(tuner, 50)
+        self.assertEqual(tuner.value, 5)
+        self.run_interval(tuner, 40)
+        self.assertEqual(tuner.value, 6)
+
+    def test_bounds(self):
+        tuner = AutoParallelism(1)
+        values = []
+        for finished in range(10, 100, 10):
+            self.run_interval(tuner, finished)
+            values.append(tuner.value)
+        self.assertEqual(values, [2, 1, 2, 1, 2, 1, 2, 1, 2])
+
+    def test_memory_pressure(self):
+        tuner = AutoParallelism(4)
+        self.pressure['memory'] = 2 * AutoParallelism.MEMORY_PRESSURE
+        self.run_interval(tuner, 40)
+        self.run_interval(tuner, 80)
+        self.assertEqual(tuner.value, 2)
+        for _ in range(3):
+            self.run_interval(tuner, 80)
+        self.assertEqual(tuner.value, 1)
+
+    def test_memory_low(self):
+        tuner = AutoParallelism(4)
+        self.run_interval(tuner, 40, test_memory=1 << 60)
+        self.assertEqual(tuner.value, 3)
+
+    def test_cpu_pressure(self):
+        tuner = AutoParallelism(4)
+        self.pressure['cpu'] = 2 * AutoParallelism.CPU_PRESSURE
+        self.run_interval(tuner, 40)
+        self.assertEqual(tuner.value, 3)
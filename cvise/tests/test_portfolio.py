@@ -0,0 +1,50 @@
+import os
+import tempfile
+import unittest
+
+from cvise.utils.portfolio import get_share, rotate_passes, SnapshotExchange
+
+
+class PortfolioTestCase(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.folder.cleanup()
+
+    def write(self, member, content):
+        folder = os.path.join(self.folder.name, f'member-{member}')
+        os.makedirs(folder, exist_ok=True)
+        path = os.path.join(folder, 'test.c')
+        with open(path, 'w') as f:
+            f.write(content)
+        return path
+
+    def test_rotate_passes(self):
+        passes = ['a', 'b', 'c', 'd']
+        self.assertEqual(rotate_passes(passes, 0, 3), passes)
+        self.assertEqual(rotate_passes(passes, 1, 3), ['b', 'c', 'd', 'a'])
+        self.assertEqual(rotate_passes(passes, 2, 3), ['c', 'd', 'a', 'b'])
+
+    def test_share(self):
+        self.assertEqual([get_share(8, m, 3) for m in range(3)], [3, 3, 2])
+        self.assertEqual([get_share(2, m, 3) for m in range(3)], [1, 1, 1])
+
+    def test_exchange(self):
+        first = SnapshotExchange(self.folder.name, 0)
+        second = SnapshotExchange(self.folder.name, 1)
+        first_path = self.write(0, 'int a;\n')
+        second_path = self.write(1, 'int a; int b;\n')
+        self.assertIsNone(first.get_smaller([first_path], 7))
+
+        first.publish([first_path], 7)
+        second.publish([second_path], 14)
+        # the own snapshot is never adopted
+        self.assertEqual(first.get_smaller([first_path], 100), {'test.c': b'int a; int b;\n'})
+        self.assertEqual(second.get_smaller([second_path], 14), {'test.c': b'int a;\n'})
+        self.assertIsNone(second.get_smaller([second_path], 7))
+        self.assertEqual(first.find_smaller([first_path], 100), second.get_path(1))
+
+        # only snapshots of the same test cases are adopted
+        other_path = os.path.join(self.folder.name, 'member-1', 'other.c')
+        self.assertIsNone(second.get_smaller([other_path], 14))
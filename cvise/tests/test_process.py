@@ -0,0 +1,50 @@
+import os
+import signal
+import subprocess
+import time
+import unittest
+
+from cvise.passes.abstract import ProcessEventNotifier
+from cvise.utils.process import ProcessGroups, ProcessGroupsFullError
+
+
+def is_running(pid):
+    try:
+        with open(f'/proc/{pid}/stat') as f:
+            # zombies are not reaped in some containers
+            return f.read().split()[2] != 'Z'
+    except FileNotFoundError:
+        return False
+
+
+@unittest.skipUnless(os.path.isdir('/proc'), 'requires procfs')
+class ProcessTestCase(unittest.TestCase):
+    def test_background_process_killed(self):
+        stdout, _, returncode = ProcessEventNotifier(None).run_process('sleep 10 > /dev/null 2>&1 & echo $!', shell=True)
+        self.assertEqual(returncode, 0)
+        pid = int(stdout)
+        for _ in range(100):
+            if not is_running(pid):
+                break
+            time.sleep(0.01)
+        self.assertFalse(is_running(pid))
+
+    def test_process_groups(self):
+        groups = ProcessGroups()
+        proc = ProcessEventNotifier(groups).start_process(['sleep', '10'], None, None, False)
+        self.assertIn(proc.pid, groups.pgids[:])
+        groups.kill()
+        proc.wait()
+        self.assertNotIn(proc.pid, groups.pgids[:])
+
+    def test_process_groups_full(self):
+        # a process whose group does not fit is killed, not leaked
+        groups = ProcessGroups()
+        notifier = ProcessEventNotifier(groups)
+        procs = [notifier.start_process(['sleep', '10'], None, None, False) for _ in range(ProcessGroups.SLOTS)]
+        proc = subprocess.Popen(['sleep', '10'], start_new_session=True)
+        self.assertRaises(ProcessGroupsFullError, groups.add, proc.pid)
+        self.assertEqual(proc.wait(), -signal.SIGKILL)
+        groups.kill()
+        for p in procs:
+            self.assertEqual(p.wait(), -signal.SIGKILL)
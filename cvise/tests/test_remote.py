@@ -0,0 +1,72 @@
+import os
+import socket
+import tempfile
+import threading
+import unittest
+
+from cvise.utils import remote
+from cvise.utils.error import RemoteWorkerError
+from cvise.utils.remote import get_jobs, parse_address, run_remote_test, WorkerServer
+
+
+class RemoteWorkerTestCase(unittest.TestCase):
+    def setUp(self):
+        self.server = WorkerServer(('localhost', 0), 2)
+        self.address = self.server.server_address[:2]
+        thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        thread.start()
+        self.folder = tempfile.TemporaryDirectory()
+        self.write('test.c', 'int a;\n')
+        self.write('test.h', 'int b;\n')
+        self.test_script = self.write('test.sh', '#!/bin/sh\ngrep -q a test.c && grep -q b test.h\n')
+        os.chmod(self.test_script, 0o755)
+
+    def tearDown(self):
+        remote.close_connection(self.address)
+        self.server.shutdown()
+        self.server.server_close()
+        self.folder.cleanup()
+
+    def write(self, name, content):
+        path = os.path.join(self.folder.name, name)
+        with open(path, 'w') as f:
+            f.write(content)
+        return path
+
+    def get_stored(self):
+        return os.listdir(self.server.store.root)
+
+    def test_parse_address(self):
+        self.assertEqual(parse_address('host:1234'), ('host', 1234))
+        self.assertEqual(parse_address('host'), ('host', remote.DEFAULT_PORT))
+
+    def test_jobs(self):
+        self.assertEqual(get_jobs(self.address), 2)
+
+    def test_run(self):
+        self.assertEqual(run_remote_test(self.address, self.folder.name, 'test.c', self.test_script), 0)
+        self.write('test.c', 'int b;\n')
+        self.assertEqual(run_remote_test(self.address, self.folder.name, 'test.c', self.test_script), 1)
+
+    def test_files_sent_once(self):
+        run_remote_test(self.address, self.folder.name, 'test.c', self.test_script)
+        # the header and the script are kept by the daemon, the test case is not
+        self.assertEqual(len(self.get_stored()), 2)
+        self.write('test.c', 'int aa;\n')
+        run_remote_test(self.address, self.folder.name, 'test.c', self.test_script)
+        self.assertEqual(len(self.get_stored()), 2)
+
+    def test_store_unchanged_by_test(self):
+        # the test truncates the header it gets
+        writer = self.write('writer.sh', '#!/bin/sh\n: > test.h\n')
+        os.chmod(writer, 0o755)
+        run_remote_test(self.address, self.folder.name, 'test.c', writer)
+        self.assertEqual(run_remote_test(self.address, self.folder.name, 'test.c', self.test_script), 0)
+
+    def test_unreachable(self):
+        # nothing listens on a port that was just closed
+        with socket.socket() as sock:
+            sock.bind(('localhost', 0))
+            address = sock.getsockname()
+        with self.assertRaises(RemoteWorkerError):
+            run_remote_test(address, self.folder.name, 'test.c', self.test_script)
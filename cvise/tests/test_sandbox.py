@@ -0,0 +1,85 @@
+import os
+import tempfile
+import unittest
+
+from cvise.utils.sandbox import SandboxPool, stage_files
+
+
+class SandboxTestCase(unittest.TestCase):
+    def setUp(self):
+        self.source = tempfile.TemporaryDirectory()
+        self.root = tempfile.TemporaryDirectory()
+        self.test_case = os.path.join(self.source.name, 'test.c')
+        self.header = os.path.join(self.source.name, 'test.h')
+        with open(self.test_case, 'w') as f:
+            f.write('int a;\n')
+        with open(self.header, 'w') as f:
+            f.write('int b;\n')
+
+    def tearDown(self):
+        self.source.cleanup()
+        self.root.cleanup()
+
+    def read(self, path):
+        with open(path) as f:
+            return f.read()
+
+    def test_stage(self):
+        pool = SandboxPool(self.root.name, 'cvise-')
+        folder = pool.acquire()
+        stage_files(folder, self.test_case, [self.header])
+        self.assertEqual(self.read(os.path.join(folder, 'test.c')), 'int a;\n')
+        self.assertEqual(self.read(os.path.join(folder, 'test.h')), 'int b;\n')
+        self.assertFalse(os.path.samefile(self.test_case, os.path.join(folder, 'test.c')))
+
+    def test_private_additional_file(self):
+        pool = SandboxPool(self.root.name, 'cvise-')
+        folder = pool.acquire()
+        stage_files(folder, self.test_case, [self.header])
+        with open(os.path.join(folder, 'test.h'), 'w') as f:
+            f.write('\n')
+        self.assertEqual(self.read(self.header), 'int b;\n')
+
+    def test_reuse(self):
+        pool = SandboxPool(self.root.name, 'cvise-')
+        folder = pool.acquire()
+        stage_files(folder, self.test_case, [self.header])
+        with open(os.path.join(folder, 'test.c'), 'w') as f:
+            f.write('\n')
+        with open(os.path.join(folder, 'a.out'), 'w') as f:
+            f.write('\n')
+        pool.release(folder, True)
+
+        self.assertEqual(pool.acquire(), folder)
+        stage_files(folder, self.test_case, [self.header])
+        self.assertEqual(sorted(os.listdir(folder)), ['test.c', 'test.h'])
+        self.assertEqual(self.read(os.path.join(folder, 'test.c')), 'int a;\n')
+
+    def test_unchanged_additional_file(self):
+        # a reused folder keeps the staged copy of an unchanged file
+        pool = SandboxPool(self.root.name, 'cvise-')
+        folder = pool.acquire()
+        stage_files(folder, self.test_case, [self.header])
+        inode = os.stat(os.path.join(folder, 'test.h')).st_ino
+        pool.release(folder, True)
+
+        folder = pool.acquire()
+        stage_files(folder, self.test_case, [self.header])
+        self.assertEqual(os.stat(os.path.join(folder, 'test.h')).st_ino, inode)
+
+    def test_changed_additional_file(self):
+        pool = SandboxPool(self.root.name, 'cvise-')
+        folder = pool.acquire()
+        stage_files(folder, self.test_case, [self.header])
+        os.unlink(self.header)
+        with open(self.header, 'w') as f:
+            f.write('int cc;\n')
+        stage_files(folder, self.test_case, [self.header])
+        self.assertEqual(self.read(os.path.join(folder, 'test.h')), 'int cc;\n')
+
+    def test_release_not_reusable(self):
+        pool = SandboxPool(self.root.name, 'cvise-')
+        folder = pool.acquire()
+        pool.release(folder, False)
+        self.assertFalse(os.path.exists(folder))
+        self.assertNotEqual(pool.acquire(), folder)
@@ -0,0 +1,94 @@
+from concurrent.futures import CancelledError, TimeoutError
+import os
+import time
+import unittest
+
+from cvise.utils.scheduler import Scheduler, WorkerDiedError
+from cvise.utils.worker import WorkerProcessEventNotifier
+
+
+def square(x):
+    return x * x
+
+
+def sleep(seconds):
+    time.sleep(seconds)
+    return seconds
+
+
+def sleep_process(seconds):
+    _, _, returncode = WorkerProcessEventNotifier().run_process(['sleep', str(seconds)])
+    return returncode
+
+
+def fail():
+    raise ValueError('failure')
+
+
+def die():
+    os._exit(1)
+
+
+class SchedulerTestCase(unittest.TestCase):
+    def setUp(self):
+        self.scheduler = Scheduler(2)
+
+    def tearDown(self):
+        self.scheduler.stop()
+
+    def test_results(self):
+        jobs = [self.scheduler.schedule(square, (i,)) for i in range(5)]
+        self.assertEqual([job.result() for job in jobs], [0, 1, 4, 9, 16])
+
+    def test_wait_first(self):
+        slow = self.scheduler.schedule(sleep, (10,))
+        fast = self.scheduler.schedule(sleep, (0,))
+        self.scheduler.wait([slow, fast], return_when_all=False)
+        self.assertTrue(fast.done())
+        self.assertFalse(slow.done())
+
+    def test_timeout(self):
+        job = self.scheduler.schedule(sleep, (10,), timeout=0.1)
+        self.assertIsInstance(job.exception(), TimeoutError)
+        self.assertEqual(self.scheduler.schedule(square, (3,)).result(), 9)
+
+    def test_cancel(self):
+        # the processes of a cancelled job are killed
+        running = self.scheduler.schedule(sleep_process, (10,))
+        other = self.scheduler.schedule(sleep, (10,))
+        pending = self.scheduler.schedule(sleep, (10,))
+        self.assertTrue(running.cancel())
+        self.assertTrue(pending.cancel())
+        self.assertTrue(running.cancelled())
+        self.assertFalse(other.done())
+        # the worker of the cancelled test is reused once it finishes
+        self.assertEqual(self.scheduler.schedule(square, (4,)).result(), 16)
+        self.assertEqual(len(self.scheduler.stages[Scheduler.DEFAULT_STAGE].idle), 1)
+
+    def test_exception(self):
+        self.assertIsInstance(self.scheduler.schedule(fail).exception(), ValueError)
+        self.assertIsInstance(self.scheduler.schedule(die).exception(), WorkerDiedError)
+        self.assertEqual(self.scheduler.schedule(square, (5,)).result(), 25)
+
+    def test_stages(self):
+        # a job continues in the next stage unless the continuation returns None
+        self.scheduler.add_stage('first', 1)
+
+        def continuation(value):
+            if value > 10:
+                return None
+            return (square, (value,), Scheduler.DEFAULT_STAGE, None)
+
+        jobs = [self.scheduler.schedule(square, (i,), stage='first', continuation=continuation) for i in range(5)]
+        self.assertEqual([job.result() for job in jobs], [0, 1, 16, 81, 16])
+        self.assertEqual(len(self.scheduler.stages['first'].idle), 1)
+
+    def test_stage_cancel(self):
+        self.scheduler.add_stage('first', 1)
+        job = self.scheduler.schedule(sleep, (0,), stage='first',
+                                      continuation=lambda value: (sleep, (10,), Scheduler.DEFAULT_STAGE, None))
+        while job.stage != Scheduler.DEFAULT_STAGE:
+            self.scheduler.process_events(None)
+        self.assertFalse(job.done())
+        self.assertTrue(job.cancel())
+        self.assertRaises(CancelledError, job.result)
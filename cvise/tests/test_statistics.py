@@ -0,0 +1,58 @@
+import unittest
+
+from cvise.utils.statistics import AdaptiveTimeout, SinglePassStatistic
+
+
+class AdaptiveTimeoutTestCase(unittest.TestCase):
+    def test_timeout(self):
+        timeout = AdaptiveTimeout(300)
+        self.assertEqual(timeout.value, 300)
+        timeout.add(0.1)
+        self.assertEqual(timeout.value, AdaptiveTimeout.FLOOR)
+        timeout.add(5)
+        self.assertEqual(timeout.value, 5 * AdaptiveTimeout.FACTOR)
+        timeout.add(100)
+        self.assertEqual(timeout.value, 300)
+
+    def test_percentile(self):
+        timeout = AdaptiveTimeout(300)
+        # a single outlier does not set the timeout
+        for _ in range(199):
+            timeout.add(2)
+        timeout.add(25)
+        self.assertEqual(timeout.value, 2 * AdaptiveTimeout.FACTOR)
+
+    def test_window(self):
+        # old runtimes leave the window
+        timeout = AdaptiveTimeout(300)
+        for _ in range(AdaptiveTimeout.WINDOW):
+            timeout.add(20)
+        self.assertEqual(timeout.value, 200)
+        for _ in range(AdaptiveTimeout.WINDOW):
+            timeout.add(2)
+        self.assertEqual(timeout.value, 20)
+        self.assertEqual(timeout.sorted_runtimes, sorted(timeout.runtimes))
+
+    def test_timeout_raises(self):
+        timeout = AdaptiveTimeout(300)
+        timeout.add(0.1)
+        self.assertEqual(timeout.value, AdaptiveTimeout.FLOOR)
+        timeout.add_timeout(AdaptiveTimeout.FLOOR)
+        self.assertEqual(timeout.value, 100)
+
+
+class SinglePassStatisticTestCase(unittest.TestCase):
+    def test_gain(self):
+        stat = SinglePassStatistic('lines::0')
+        self.assertIsNone(stat.gain)
+        stat.add_run(100, 2)
+        self.assertEqual(stat.gain, 50)
+        stat.add_run(0, 1)
+        self.assertEqual(stat.gain, 25)
+        self.assertEqual(stat.idle_runs, 1)
+        stat.add_run(0, 0)
+        self.assertEqual(stat.idle_runs, 2)
+        stat.add_run(10, 0)
+        self.assertEqual(stat.idle_runs, 0)
+        self.assertEqual(stat.removed_bytes, 110)
+        self.assertEqual(stat.cpu_seconds, 3)
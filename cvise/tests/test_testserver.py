@@ -0,0 +1,84 @@
+import os
+import tempfile
+import time
+import unittest
+
+from cvise.passes.abstract import PassResult
+from cvise.utils.error import InterestingnessServerError
+from cvise.utils.scheduler import Scheduler
+from cvise.utils.testserver import InterestingnessServer
+from cvise.utils import worker
+
+
+class InterestingnessServerTestCase(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.TemporaryDirectory()
+        self.servers = []
+
+    def tearDown(self):
+        for server in self.servers:
+            server.stop()
+        self.folder.cleanup()
+
+    def get_server(self, loop):
+        script = os.path.join(self.folder.name, 'test.sh')
+        with open(script, 'w') as f:
+            f.write('#!/bin/bash\necho $$ >> ' + os.path.join(self.folder.name, 'starts') + '\n' + loop)
+        os.chmod(script, 0o755)
+        server = InterestingnessServer(script)
+        self.servers.append(server)
+        return server
+
+    def get_variant(self, content):
+        folder = tempfile.mkdtemp(dir=self.folder.name)
+        with open(os.path.join(folder, 'test.c'), 'w') as f:
+            f.write(content)
+        return folder
+
+    def get_starts(self):
+        with open(os.path.join(self.folder.name, 'starts')) as f:
+            return len(f.readlines())
+
+    def test_run(self):
+        server = self.get_server('while read -r f; do grep -q a "$f/test.c"; echo $?; done\n')
+        self.assertEqual(server.run(self.get_variant('int a;\n')), 0)
+        self.assertEqual(server.run(self.get_variant('int b;\n')), 1)
+        self.assertEqual(server.run(self.get_variant('int aa;\n')), 0)
+        self.assertEqual(self.get_starts(), 1)
+
+    def test_restart(self):
+        # the server exits after one variant, it is started again for the next one
+        server = self.get_server('read -r f; grep -q a "$f/test.c"; echo $?\n')
+        self.assertEqual(server.run(self.get_variant('int a;\n')), 0)
+        self.assertEqual(server.run(self.get_variant('int a;\n')), 0)
+        self.assertEqual(server.run(self.get_variant('int b;\n')), 1)
+        self.assertEqual(self.get_starts(), 3)
+
+    def test_bad_reply(self):
+        server = self.get_server('while read -r f; do echo ok; done\n')
+        with self.assertRaises(InterestingnessServerError):
+            server.run(self.get_variant('int a;\n'))
+        self.assertIsNone(server.proc)
+        self.assertEqual(self.get_starts(), 2)
+
+    def test_cancel(self):
+        # a cancelled variant kills the server that tests it, the next variant starts a new one
+        self.get_server('while read -r f; do grep -q slow "$f/test.c" && touch "$f/started" && sleep 60;'
+                        ' grep -q a "$f/test.c"; echo $?; done\n')
+        script = os.path.join(self.folder.name, 'test.sh')
+        outcome = (PassResult.OK, None, None, None, None)
+        scheduler = Scheduler(1, worker.init_worker, (None, True))
+        try:
+            folder = self.get_variant('int slow;\n')
+            start = time.monotonic()
+            slow = scheduler.schedule(worker.test_variant, (folder, script, outcome))
+            while not os.path.exists(os.path.join(folder, 'started')) and time.monotonic() - start < 10:
+                time.sleep(0.01)
+            slow.cancel()
+            scheduler.drain()
+            self.assertLess(time.monotonic() - start, 30)
+            job = scheduler.schedule(worker.test_variant, (self.get_variant('int a;\n'), script, outcome))
+            self.assertEqual(job.result()[1], 0)
+            self.assertEqual(self.get_starts(), 2)
+        finally:
+            scheduler.stop()
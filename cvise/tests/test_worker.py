@@ -0,0 +1,84 @@
+import os
+import tempfile
+import unittest
+
+from cvise.passes.abstract import BinaryState, PassResult
+from cvise.utils.cache import hash_context, hash_variant
+from cvise.utils.worker import (apply_delta, init_worker, is_tested, speculate_new, state_delta, transform_variant,
+                                write_snapshot)
+
+
+class AppendPass:
+    def transform(self, test_case, state, process_event_notifier):
+        with open(test_case, 'a') as f:
+            f.write(state)
+        return (PassResult.OK, state)
+
+
+class FormatPass:
+    def new(self, test_case, check_sanity):
+        with open(test_case, 'a') as f:
+            f.write('\n')
+        self.formatted = True
+        return 0
+
+
+class WorkerTestCase(unittest.TestCase):
+    def test_binary_state_delta(self):
+        base = BinaryState.create(10)
+        base.functions = list(range(10))
+        state = base.advance()
+        partial, delta = state_delta(base, state)
+        self.assertTrue(partial)
+        self.assertNotIn('functions', delta)
+        self.assertNotIn('instances', delta)
+
+        new_state = apply_delta(base, (partial, delta))
+        self.assertEqual(new_state.index, state.index)
+        self.assertEqual(new_state.chunk, state.chunk)
+        self.assertIs(new_state.functions, base.functions)
+        self.assertEqual(base.index, 0)
+
+    def test_dict_state_delta(self):
+        base = {'modifications': [((0, 1), 'a')], 'index': 0}
+        state = base.copy()
+        state['index'] += 1
+        self.assertEqual(state_delta(base, state), (True, {'index': 1}))
+        self.assertEqual(apply_delta(base, state_delta(base, state)), state)
+
+    def test_scalar_state_delta(self):
+        self.assertEqual(state_delta(1, 2), (False, 2))
+        self.assertEqual(apply_delta(1, (False, 2)), 2)
+        self.assertEqual(state_delta(None, 3), (False, 3))
+
+    def test_known_result(self):
+        with tempfile.TemporaryDirectory() as folder:
+            test_case = os.path.join(folder, 'test.c')
+            with open(test_case, 'w') as f:
+                f.write('int a;')
+            context = hash_context(test_case, [])
+            snapshot = os.path.join(folder, 'snapshot.pickle')
+            write_snapshot(snapshot, AppendPass(), '', (context, {}))
+
+            outcome = transform_variant(snapshot, (False, ' int b;'), folder, 'test.c')
+            self.assertFalse(is_tested(outcome))
+            self.assertEqual(outcome[3], hash_variant(context, test_case))
+
+            # the variant is not tested again
+            with open(test_case, 'w') as f:
+                f.write('int a;')
+            init_worker({outcome[3]: 1})
+            outcome = transform_variant(snapshot, (False, ' int b;'), folder, 'test.c')
+            self.assertTrue(is_tested(outcome))
+            self.assertEqual(outcome[1], 1)
+
+    def test_speculate_new(self):
+        with tempfile.TemporaryDirectory() as folder:
+            test_case = os.path.join(folder, 'test.c')
+            with open(test_case, 'w') as f:
+                f.write('int a;')
+            pass_, state, data = speculate_new(FormatPass(), test_case)
+            self.assertTrue(pass_.formatted)
+            self.assertEqual(state, 0)
+            self.assertEqual(data, b'int a;\n')
+            self.assertIsNone(speculate_new(FormatPass(), os.path.join(folder, 'missing', 'test.c')))
@@ -0,0 +1,165 @@
+from collections import OrderedDict
+import hashlib
+import logging
+import os
+import sqlite3
+import zlib
+
+# Outcomes of the interestingness test, keyed by a hash of the content of all test
+# files. Different passes (and later rounds of the main passes) often produce the
+# same variant, which is then not tested again.
+
+
+def hash_context(test_case, additional_files):
+    # the files that are not transformed are hashed once per batch
+    h = hashlib.blake2b(digest_size=16)
+    h.update(os.path.basename(test_case).encode())
+    for path in sorted(additional_files, key=os.path.basename):
+        h.update(b'\0' + os.path.basename(path).encode() + b'\0')
+        h.update(hash_file(path))
+    return h.digest()
+
+
+def hash_variant(context, path):
+    h = hashlib.blake2b(context, digest_size=16)
+    with open(path, 'rb') as f:
+        h.update(f.read())
+    return h.digest()
+
+
+def hash_data(data):
+    return hashlib.blake2b(data, digest_size=16).digest()
+
+
+def hash_file(path):
+    with open(path, 'rb') as f:
+        return hash_data(f.read())
+
+
+# Results stored in a SQLite database, shared by restarted runs and concurrent
+# C-Vise instances. Results of different interestingness tests are kept apart.
+class ResultStore:
+    FILE_NAME = 'results.sqlite'
+    LOCK_TIMEOUT = 60
+
+    def __init__(self, cache_dir, test_script):
+        os.makedirs(cache_dir, exist_ok=True)
+        self.script = hash_file(test_script)
+        self.last_rowid = 0
+        self.pending = []
+        self.connection = sqlite3.connect(os.path.join(cache_dir, self.FILE_NAME), timeout=self.LOCK_TIMEOUT)
+        # readers do not block the writer with write-ahead logging
+        self.connection.execute('PRAGMA journal_mode=WAL')
+        with self.connection:
+            self.connection.execute('CREATE TABLE IF NOT EXISTS results (script BLOB, digest BLOB, returncode INTEGER, '
+                                    'seconds REAL, PRIMARY KEY (script, digest))')
+
+    # Return the results that were added (by any instance) since the last call
+    def load(self):
+        try:
+            rows = self.connection.execute('SELECT rowid, digest, returncode, seconds FROM results '
+                                           'WHERE script = ? AND rowid > ?', (self.script, self.last_rowid)).fetchall()
+        except sqlite3.Error as e:
+            logging.warning(f'cannot read the result cache: {e}')
+            return []
+        for row in rows:
+            self.last_rowid = max(self.last_rowid, row[0])
+        return [row[1:] for row in rows]
+
+    def add(self, digest, returncode, seconds):
+        self.pending.append((self.script, digest, returncode, seconds))
+
+    def flush(self):
+        if not self.pending:
+            return
+        try:
+            with self.connection:
+                self.connection.executemany('INSERT OR IGNORE INTO results VALUES (?, ?, ?, ?)', self.pending)
+        except sqlite3.Error as e:
+            logging.warning(f'cannot write the result cache: {e}')
+        self.pending = []
+
+
+class ResultCache:
+    def __init__(self, store=None):
+        # digest -> (exit code, test seconds)
+        self.results = {}
+        self.store = store
+        self.hits = 0
+        self.misses = 0
+        self.saved_seconds = 0
+
+    def add(self, digest, returncode, seconds):
+        self.misses += 1
+        self.results[digest] = (returncode, seconds)
+        if self.store:
+            self.store.add(digest, returncode, seconds)
+
+    # Write the new results to the store and return the digests of the results
+    # other instances added to it meanwhile
+    def sync(self):
+        if not self.store:
+            return []
+        self.store.flush()
+        digests = []
+        for digest, returncode, seconds in self.store.load():
+            if digest not in self.results:
+                self.results[digest] = (returncode, seconds)
+                digests.append(digest)
+        return digests
+
+    def add_hit(self, digest):
+        self.hits += 1
+        if digest in self.results:
+            self.saved_seconds += self.results[digest][1]
+
+    # exit codes by digest, the form workers look variants up in
+    def get_returncodes(self, digests=None):
+        if digests is None:
+            digests = self.results.keys()
+        return {d: self.results[d][0] for d in digests}
+
+    @property
+    def hit_rate(self):
+        total = self.hits + self.misses
+        return 100.0 * self.hits / total if total else 0
+
+
+# Content of a test case after a pass, by the pass and the digest of the content
+# before it. The content is stored compressed and the least recently used entries
+# are evicted when the memory limit (in bytes) is exceeded.
+class PassCache:
+    COMPRESSION_LEVEL = 1
+    # estimated size of the key and the bookkeeping of an entry
+    ENTRY_SIZE = 200
+
+    def __init__(self, memory_limit=None):
+        self.memory_limit = memory_limit
+        self.entries = OrderedDict()
+        self.size = 0
+
+    def contains(self, pass_key, digest):
+        return (pass_key, digest) in self.entries
+
+    # Return the content after the pass, or None if it is not known
+    def get(self, pass_key, digest, data):
+        key = (pass_key, digest)
+        if key not in self.entries:
+            return None
+        self.entries.move_to_end(key)
+        compressed = self.entries[key]
+        # a pass that did not change the content is common, and stored as None
+        return data if compressed is None else zlib.decompress(compressed)
+
+    def add(self, pass_key, digest, data):
+        key = (pass_key, digest)
+        self.remove(key)
+        compressed = None if hash_data(data) == digest else zlib.compress(data, self.COMPRESSION_LEVEL)
+        self.entries[key] = compressed
+        self.size += self.ENTRY_SIZE + len(compressed or b'')
+        while self.memory_limit is not None and self.size > self.memory_limit and self.entries:
+            self.remove(next(iter(self.entries)))
+
+    def remove(self, key):
+        if key in self.entries:
+            self.size -= self.ENTRY_SIZE + len(self.entries.pop(key) or b'')
@@ -0,0 +1,59 @@
+import os
+import pickle
+import tempfile
+
+from cvise.utils.error import InvalidCheckpointError
+
+# Progress of a reduction, written from time to time so that an interrupted run
+# can be resumed where it left off (see --checkpoint and --resume).
+
+
+class PassProgress:
+    def __init__(self, pass_, test_cases, index, starting_size, success_count, digest_before_pass, state):
+        # the pass object itself, as passes keep some state (e.g. the clang_delta standard)
+        self.pass_ = pass_
+        # order in which the pass processes the test cases and the current one
+        self.test_cases = test_cases
+        self.index = index
+        self.starting_size = starting_size
+        self.success_count = success_count
+        self.digest_before_pass = digest_before_pass
+        # the next state to try
+        self.state = state
+
+
+class Checkpoint:
+    VERSION = 1
+
+    def __init__(self):
+        self.version = self.VERSION
+        # position in the pass group: category ('first', 'main' or 'last') and pass index
+        self.category = None
+        self.pass_index = 0
+        # total size of the test cases at the start of every round of the main passes
+        self.main_sizes = []
+        # indices of the main passes in the order of the current round
+        self.main_order = []
+        self.pass_progress = None
+        self.pass_statistics = {}
+        self.pass_cache = None
+        # the test cases must match the progress, so their content is saved as well
+        self.test_cases = {}
+
+    def write(self, path):
+        # a checkpoint is replaced atomically, an interrupted write keeps the previous one
+        folder = os.path.dirname(os.path.abspath(path))
+        with tempfile.NamedTemporaryFile(mode='wb', dir=folder, delete=False) as f:
+            pickle.dump(self, f, protocol=pickle.HIGHEST_PROTOCOL)
+        os.replace(f.name, path)
+
+    @classmethod
+    def read(cls, path):
+        try:
+            with open(path, 'rb') as f:
+                checkpoint = pickle.load(f)
+        except (OSError, pickle.UnpicklingError, EOFError, AttributeError) as e:
+            raise InvalidCheckpointError(path, str(e))
+        if not isinstance(checkpoint, cls) or checkpoint.version != cls.VERSION:
+            raise InvalidCheckpointError(path, 'unsupported version')
+        return checkpoint
@@ -90,6 +90,16 @@ class MissingPassGroupsError(CViseError):
         return 'Could not find a directory with definitions for pass groups!'
 
 
+class InvalidCheckpointError(CViseError):
+    def __init__(self, path, reason):
+        super().__init__()
+        self.path = path
+        self.reason = reason
+
+    def __str__(self):
+        return f"Cannot resume from checkpoint '{self.path}': {self.reason}!"
+
+
 class PassBugError(CViseError):
     MSG = """***************************************************
 
@@ -115,12 +125,17 @@ and creating an issue at https://github.com/marxin/cvise/issues and we will try
 
 
 class InsaneTestCaseError(CViseError):
-    def __init__(self, test_cases, test):
+    def __init__(self, test_cases, test, test_server=False):
         super().__init__()
         self.test_cases = test_cases
         self.test = test
+        self.test_server = test_server
 
     def __str__(self):
+        if self.test_server:
+            run = 'echo $DIR | CVISE_TEST_SERVER=1 {test}'
+        else:
+            run = '{test}\n  echo $?'
         message = """C-Vise cannot run because the interestingness test does not return
 zero. Please ensure that it does so not only in the directory where
 you are invoking C-Vise, but also in an arbitrary temporary
@@ -130,12 +145,30 @@ words, running these commands:
   DIR=`mktemp -d`
   cp {test_cases} $DIR
   cd $DIR
-  {test}
-  echo $?
+  {run}
 
 should result in '0' being echoed to the terminal.
 Please ensure that the test script takes no arguments; it should be hard-coded to refer
 to the same file that is passed as an argument to C-Vise.
 
-See 'cvise.py --help' for more information.""".format(test_cases=' '.join(self.test_cases), test=self.test)
+See 'cvise.py --help' for more information.""".format(test_cases=' '.join(self.test_cases), run=run.format(test=self.test))
         return message
+
+
+class RemoteWorkerError(CViseError):
+    def __init__(self, address, reason):
+        super().__init__(address, reason)
+        self.address = address
+        self.reason = reason
+
+    def __str__(self):
+        return f"The remote worker '{self.address}' failed: {self.reason}!"
+
+
+class InterestingnessServerError(CViseError):
+    def __init__(self, test_script):
+        super().__init__(test_script)
+        self.test_script = test_script
+
+    def __str__(self):
+        return f"The test server '{self.test_script}' exited or did not reply with an exit code!"
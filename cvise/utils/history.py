@@ -0,0 +1,98 @@
+from collections import namedtuple
+import logging
+import math
+import os
+import sqlite3
+
+from cvise.utils.statistics import SinglePassStatistic
+
+# Outcomes of the passes in earlier reductions, shared by all runs that use the same
+# database. They are kept apart by features of the input: the language (the file
+# extensions of the test cases), the size class and the pass group. The outcomes for
+# similar inputs are priors for the order of the passes and their max-transforms limits.
+
+COLUMNS = ('runs', 'useful_runs', 'worked', 'failed', 'seconds', 'cpu_seconds', 'removed_bytes')
+
+
+class PassRecord(namedtuple('PassRecord', COLUMNS)):
+    @property
+    def gain(self):
+        return self.removed_bytes / max(self.cpu_seconds, SinglePassStatistic.MIN_SECONDS)
+
+
+def get_features(test_cases, pass_group_name):
+    extensions = sorted({os.path.splitext(test_case)[1].lower() for test_case in test_cases})
+    size = sum(os.path.getsize(test_case) for test_case in test_cases)
+    # the size classes grow by a factor of 4
+    return (','.join(extensions), size.bit_length() // 2, pass_group_name)
+
+
+class PassHistory:
+    LOCK_TIMEOUT = 60
+    # outcomes of fewer runs are not used
+    MIN_RUNS = 3
+    # passes that removed something in a smaller share of their runs start dormant
+    DORMANT_SHARE = 0.05
+    # passes with a smaller share of the best gain are limited to a multiple of
+    # their usual number of transformations per run
+    LOW_GAIN_SHARE = 0.1
+    TRANSFORMS_FACTOR = 2
+    MIN_TRANSFORMS = 10
+
+    def __init__(self, path, features):
+        self.features = features
+        # pass names before the limits were applied
+        self.names = {}
+        self.connection = sqlite3.connect(path, timeout=self.LOCK_TIMEOUT)
+        with self.connection:
+            self.connection.execute('CREATE TABLE IF NOT EXISTS passes (language TEXT, size_class INTEGER, '
+                                    'pass_group TEXT, pass TEXT, runs INTEGER, useful_runs INTEGER, worked INTEGER, '
+                                    'failed INTEGER, seconds REAL, cpu_seconds REAL, removed_bytes INTEGER, '
+                                    'PRIMARY KEY (language, size_class, pass_group, pass))')
+
+    def query(self, condition, args):
+        sums = ', '.join(f'SUM({c})' for c in COLUMNS)
+        rows = self.connection.execute(f'SELECT pass, {sums} FROM passes WHERE {condition} GROUP BY pass', args)
+        return {row[0]: PassRecord(*row[1:]) for row in rows}
+
+    # Outcomes by pass name. Inputs of other sizes only count for passes that did
+    # not run often enough on inputs of the same size class.
+    def load(self):
+        language, _, pass_group = self.features
+        try:
+            records = self.query('language = ? AND pass_group = ?', (language, pass_group))
+            records.update((name, record) for name, record in self.query(
+                'language = ? AND size_class = ? AND pass_group = ?', self.features).items()
+                if record.runs >= self.MIN_RUNS)
+        except sqlite3.Error as e:
+            logging.warning(f'cannot read the pass history: {e}')
+            return {}
+        return {name: record for name, record in records.items() if record.runs >= self.MIN_RUNS}
+
+    def apply(self, passes, pass_statistic, dormant_runs):
+        records = self.load()
+        known = {p: records[repr(p)] for p in passes if repr(p) in records}
+        best_gain = max((record.gain for record in known.values()), default=0)
+        for p, record in known.items():
+            name = repr(p)
+            if p.max_transforms is None and record.worked and record.gain < self.LOW_GAIN_SHARE * best_gain:
+                p.max_transforms = max(self.MIN_TRANSFORMS, math.ceil(self.TRANSFORMS_FACTOR * record.worked / record.runs))
+                self.names[repr(p)] = name
+                logging.debug(f'{name} is limited to {p.max_transforms} transformations per run')
+            idle_runs = dormant_runs if record.useful_runs < self.DORMANT_SHARE * record.runs else 0
+            pass_statistic.set_prior(p, record.gain, idle_runs)
+
+    def add(self, pass_statistic):
+        rows = []
+        for pass_name, stat in pass_statistic.stats.items():
+            if stat.runs:
+                rows.append(self.features + (self.names.get(pass_name, pass_name), stat.runs, stat.useful_runs,
+                                             stat.worked, stat.failed, stat.total_seconds, stat.cpu_seconds,
+                                             stat.removed_bytes))
+        updates = ', '.join(f'{c} = {c} + excluded.{c}' for c in COLUMNS)
+        try:
+            with self.connection:
+                self.connection.executemany('INSERT INTO passes VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) '
+                                            f'ON CONFLICT (language, size_class, pass_group, pass) DO UPDATE SET {updates}', rows)
+        except sqlite3.Error as e:
+            logging.warning(f'cannot write the pass history: {e}')
@@ -0,0 +1,64 @@
+# Combine successful variants of the same test case whose edits do not overlap.
+# An edit is described by the smallest range of the original data that was
+# replaced, i.e. (start, end, replacement).
+
+
+def common_prefix_length(a, b, limit):
+    # binary search with slice comparisons is much faster than a Python loop
+    low, high = 0, limit
+    while low < high:
+        mid = (low + high + 1) // 2
+        if a[:mid] == b[:mid]:
+            low = mid
+        else:
+            high = mid - 1
+    return low
+
+
+def common_suffix_length(a, b, limit):
+    low, high = 0, limit
+    while low < high:
+        mid = (low + high + 1) // 2
+        if a[len(a) - mid:] == b[len(b) - mid:]:
+            low = mid
+        else:
+            high = mid - 1
+    return low
+
+
+def get_edit(original, data):
+    if original == data:
+        return None
+    limit = min(len(original), len(data))
+    prefix = common_prefix_length(original, data, limit)
+    suffix = common_suffix_length(original, data, limit - prefix)
+    return (prefix, len(original) - suffix, data[prefix:len(data) - suffix])
+
+
+def edits_overlap(a, b):
+    if a[0] > b[0]:
+        a, b = b, a
+    if a[1] < b[0]:
+        return False
+    # touching edits can be combined only if both replace something
+    return a[1] > b[0] or a[0] == a[1] or b[0] == b[1]
+
+
+def apply_edits(original, edits):
+    data = original
+    for start, end, replacement in sorted(edits, reverse=True):
+        data = data[:start] + replacement + data[end:]
+    return data
+
+
+# Return the data with the edits of all variants that can be combined with the
+# first one (which always wins), and the number of merged variants
+def merge_variants(original, variants):
+    edits = []
+    for data in variants:
+        edit = get_edit(original, data)
+        if edit is None:
+            continue
+        if not any(edits_overlap(edit, other) for other in edits):
+            edits.append(edit)
+    return (apply_edits(original, edits), len(edits))
@@ -1,6 +1,46 @@
+import os
+import shutil
+import tempfile
+
+from cvise.utils.merge import get_edit
+
+
 def is_readable_file(filename):
     try:
         open(filename).read()
         return True
     except UnicodeDecodeError:
         return False
+
+
+# Replace the content of path by data with a new file, a process that reads the old
+# file (or has a link to it) never sees a partly written file
+def replace_file(path, data):
+    with tempfile.NamedTemporaryFile(mode='wb', dir=os.path.dirname(os.path.abspath(path)), delete=False) as f:
+        f.write(data)
+    shutil.copymode(path, f.name)
+    os.replace(f.name, path)
+
+
+def count_lines(data):
+    # blank lines are not counted
+    return sum(1 for line in data.splitlines() if line.strip())
+
+
+def find_line_end(data, start):
+    ends = [i for i in (data.find(b'\n', start), data.find(b'\r', start)) if i != -1]
+    return min(ends) if ends else len(data)
+
+
+# Return the change of the line count between two versions of a file. Only the
+# lines touched by the edit are counted; the file is cut at line breaks, so the
+# lines before and after the edit are the same in both versions.
+def get_line_delta(old, new):
+    edit = get_edit(old, new)
+    if edit is None:
+        return 0
+    start, end, replacement = edit
+    line_start = max(old.rfind(b'\n', 0, start), old.rfind(b'\r', 0, start)) + 1
+    tail = find_line_end(old, end) - end
+    new_end = start + len(replacement)
+    return count_lines(new[line_start:new_end + tail]) - count_lines(old[line_start:end + tail])
@@ -0,0 +1,81 @@
+import os
+import time
+
+import psutil
+
+# Number of interestingness tests run in parallel with --n=auto. The rate of finished
+# tests is measured in intervals: the number keeps moving in the same direction while
+# the rate improves, and turns around otherwise. Memory pressure (PSI) or too little
+# available memory for the running tests make it shrink, CPU pressure stops it growing.
+
+PRESSURE_DIR = '/proc/pressure'
+
+
+# Share of time (in percent, over the last 10 seconds) some tasks were stalled on
+# the resource, or None if the kernel does not report it
+def read_pressure(resource):
+    try:
+        with open(os.path.join(PRESSURE_DIR, resource)) as f:
+            for line in f:
+                kind, *values = line.split()
+                if kind == 'some':
+                    return float(dict(v.split('=') for v in values)['avg10'])
+    except (OSError, ValueError, KeyError):
+        pass
+    return None
+
+
+class AutoParallelism:
+    INTERVAL = 5
+    # relative change of the rate that is not noise
+    TOLERANCE = 0.05
+    MAX_FACTOR = 2
+    MEMORY_PRESSURE = 10
+    CPU_PRESSURE = 50
+    # available memory is kept for this many more tests
+    MEMORY_RESERVE = 2
+
+    def __init__(self, initial):
+        self.value = initial
+        self.maximum = self.MAX_FACTOR * initial
+        self.step = 1
+        self.last_rate = None
+        self.start_interval()
+
+    def start_interval(self):
+        self.start = time.monotonic()
+        self.finished = 0
+
+    def add_finished(self):
+        self.finished += 1
+
+    @staticmethod
+    def is_above(pressure, limit):
+        return pressure is not None and pressure > limit
+
+    def is_memory_low(self, memory_per_test):
+        return memory_per_test is not None and psutil.virtual_memory().available < self.MEMORY_RESERVE * memory_per_test
+
+    # Adjust the value at the end of an interval; get_test_memory returns the average
+    # memory of a running test. Return whether the value changed.
+    def update(self, get_test_memory):
+        elapsed = time.monotonic() - self.start
+        if elapsed < self.INTERVAL:
+            return False
+        rate = self.finished / elapsed
+        if self.is_above(read_pressure('memory'), self.MEMORY_PRESSURE) or self.is_memory_low(get_test_memory()):
+            self.step = -1
+        elif self.last_rate is not None and rate <= self.last_rate * (1 + self.TOLERANCE):
+            self.step = -self.step
+        elif self.step > 0 and self.is_above(read_pressure('cpu'), self.CPU_PRESSURE):
+            self.step = -1
+        elif not 1 <= self.value + self.step <= self.maximum:
+            # the value cannot keep moving at a bound
+            self.step = -self.step
+        self.last_rate = rate
+        self.start_interval()
+
+        value = min(max(self.value + self.step, 1), self.maximum)
+        changed = value != self.value
+        self.value = value
+        return changed
@@ -0,0 +1,142 @@
+import logging
+import os
+import pickle
+import shutil
+import subprocess
+import tempfile
+import time
+
+# A portfolio runs several C-Vise processes (members) on their own copies of the test
+# cases, each with a different order of the main passes and a share of the test
+# processes. Between passes, a member publishes its test cases and adopts the
+# smallest snapshot another member published.
+
+
+def get_member_folder(root, member):
+    return os.path.join(root, f'member-{member}')
+
+
+# The main passes of a member start at a different pass
+def rotate_passes(passes, member, size):
+    shift = member * len(passes) // size
+    return passes[shift:] + passes[:shift]
+
+
+def get_share(total, member, size):
+    return max(1, total // size + (member < total % size))
+
+
+class SnapshotExchange:
+    def __init__(self, root, member):
+        self.root = root
+        self.member = member
+        self.published_size = None
+
+    def get_path(self, member):
+        return os.path.join(self.root, f'snapshot-{member}.pickle')
+
+    # A snapshot file holds a header (size, names of the test cases) and then the
+    # content of the test cases, so that it can be compared without reading all of it
+    def publish(self, test_cases, size):
+        if size == self.published_size:
+            return
+        snapshot = {}
+        for test_case in test_cases:
+            with open(test_case, 'rb') as f:
+                snapshot[os.path.basename(test_case)] = f.read()
+        # the snapshot is replaced atomically, readers never see a partial one
+        with tempfile.NamedTemporaryFile(mode='wb', dir=self.root, delete=False) as f:
+            pickle.dump((size, sorted(snapshot)), f, protocol=pickle.HIGHEST_PROTOCOL)
+            pickle.dump(snapshot, f, protocol=pickle.HIGHEST_PROTOCOL)
+        os.replace(f.name, self.get_path(self.member))
+        self.published_size = size
+
+    # Return the path of the smallest snapshot of the other members if it is smaller
+    # than size; only the headers are read
+    def find_smaller(self, test_cases, size):
+        names = sorted(os.path.basename(test_case) for test_case in test_cases)
+        best = None
+        with os.scandir(self.root) as entries:
+            paths = [e.path for e in entries if e.name.startswith('snapshot-') and e.path != self.get_path(self.member)]
+        for path in paths:
+            try:
+                with open(path, 'rb') as f:
+                    snapshot_size, snapshot_names = pickle.load(f)
+            except (OSError, pickle.UnpicklingError, EOFError, ValueError, TypeError):
+                continue
+            if snapshot_names == names and snapshot_size < size:
+                best = path
+                size = snapshot_size
+        return best
+
+    @staticmethod
+    def load(path):
+        try:
+            with open(path, 'rb') as f:
+                pickle.load(f)
+                return pickle.load(f)
+        except (OSError, pickle.UnpicklingError, EOFError):
+            return None
+
+    # Return the smallest snapshot of the other members if it is smaller than size
+    def get_smaller(self, test_cases, size):
+        path = self.find_smaller(test_cases, size)
+        return self.load(path) if path else None
+
+
+class Portfolio:
+    POLL_INTERVAL = 1
+    LOG_FILE = 'cvise.log'
+
+    def __init__(self, size, test_cases, tmp_dir=None):
+        self.size = size
+        self.test_cases = test_cases
+        self.root = tempfile.mkdtemp(prefix='cvise-portfolio-', dir=tmp_dir)
+        for member in range(size):
+            folder = get_member_folder(self.root, member)
+            os.mkdir(folder)
+            for test_case in test_cases:
+                shutil.copy2(test_case, folder)
+
+    def get_log_path(self, member):
+        return os.path.join(get_member_folder(self.root, member), self.LOG_FILE)
+
+    def get_size(self, member):
+        folder = get_member_folder(self.root, member)
+        try:
+            return sum(os.path.getsize(os.path.join(folder, test_case)) for test_case in self.test_cases)
+        except OSError:
+            return None
+
+    def get_best(self, members=None):
+        sizes = {m: self.get_size(m) for m in (range(self.size) if members is None else members)}
+        sizes = {m: size for m, size in sizes.items() if size is not None}
+        return min(sizes, key=lambda m: (sizes[m], m)) if sizes else None
+
+    # Run the members (get_command returns the command line of a member) and
+    # return their exit codes. An interrupt from the terminal also stops the members.
+    def run(self, get_command):
+        processes = []
+        for member in range(self.size):
+            with open(self.get_log_path(member), 'w') as log:
+                processes.append(subprocess.Popen(get_command(member), stdout=log, stderr=subprocess.STDOUT))
+        best_size = None
+        try:
+            while any(p.poll() is None for p in processes):
+                time.sleep(self.POLL_INTERVAL)
+                best = self.get_best()
+                size = None if best is None else self.get_size(best)
+                if size is not None and (best_size is None or size < best_size):
+                    best_size = size
+                    logging.info(f'({size} bytes)')
+        except KeyboardInterrupt:
+            logging.info('Exiting now ...')
+        return [p.wait() for p in processes]
+
+    def adopt(self, member):
+        folder = get_member_folder(self.root, member)
+        for test_case in self.test_cases:
+            shutil.copy(os.path.join(folder, test_case), test_case)
+
+    def cleanup(self):
+        shutil.rmtree(self.root, ignore_errors=True)
@@ -0,0 +1,73 @@
+import multiprocessing
+import os
+import signal
+
+import psutil
+
+# Test and transformation processes are started in their own process group, which
+# is killed as a whole: nothing they started in the background outlives them.
+
+
+def kill_process_group(pgid):
+    try:
+        if hasattr(os, 'killpg'):
+            os.killpg(pgid, signal.SIGKILL)
+        else:
+            # there are no process groups (Windows), kill the process and its descendants
+            process = psutil.Process(pgid)
+            for p in process.children(recursive=True) + [process]:
+                p.kill()
+    except (ProcessLookupError, PermissionError, psutil.NoSuchProcess):
+        pass
+
+
+class ProcessGroupsFullError(Exception):
+    pass
+
+
+# Process groups of the running processes of a test worker. They are kept in shared
+# memory, so that the scheduler can kill them even if it has to kill the worker.
+# A job runs its processes one after another, the slots leave room for passes that
+# run a few at once.
+class ProcessGroups:
+    SLOTS = 16
+
+    def __init__(self):
+        self.pgids = multiprocessing.RawArray('i', self.SLOTS)
+
+    # A group that does not fit could not be killed later, it is killed right away
+    def add(self, pgid):
+        for i in range(self.SLOTS):
+            if not self.pgids[i]:
+                self.pgids[i] = pgid
+                return
+        kill_process_group(pgid)
+        raise ProcessGroupsFullError(f'more than {self.SLOTS} process groups are running')
+
+    def remove(self, pgid):
+        for i in range(self.SLOTS):
+            if self.pgids[i] == pgid:
+                self.pgids[i] = 0
+
+    def kill(self):
+        for i in range(self.SLOTS):
+            pgid = self.pgids[i]
+            if pgid:
+                self.pgids[i] = 0
+                kill_process_group(pgid)
+
+
+# Resident memory of all descendants of the processes
+def get_descendants_memory(pids):
+    rss = 0
+    for pid in pids:
+        try:
+            children = psutil.Process(pid).children(recursive=True)
+        except psutil.Error:
+            continue
+        for child in children:
+            try:
+                rss += child.memory_info().rss
+            except psutil.Error:
+                pass
+    return rss
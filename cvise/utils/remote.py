@@ -0,0 +1,244 @@
+import os
+import pickle
+import select
+import shlex
+import shutil
+import socket
+import socketserver
+import struct
+import subprocess
+import tempfile
+import threading
+
+from cvise.utils.cache import hash_data
+from cvise.utils.error import RemoteWorkerError
+from cvise.utils.process import kill_process_group
+from cvise.utils.sandbox import link_file
+from cvise.utils.scheduler import is_cancelled, JobCancelledError
+
+# Interestingness tests can run on other hosts, in worker daemons (cvise-worker). A
+# test worker of the test manager sends the transformed test case, and the digests
+# of the other files and of the test script; the daemon asks for the files it does
+# not have yet, keeps them by their digest, runs the test in a fresh folder and
+# sends back the exit code. Messages are pickled tuples with a length prefix, the
+# daemons are meant for trusted networks only: they run the scripts they get.
+#
+#   ('hello',)                                  -> ('hello', jobs)
+#   ('test', name, data, {name: digest}, digest) -> ('missing', [digest])
+#   ('files', {digest: data})                   -> ('result', exit code)
+
+DEFAULT_PORT = 8637
+HEADER = struct.Struct('!Q')
+POLL_INTERVAL = 0.1
+CONNECT_TIMEOUT = 10
+
+
+def parse_address(value):
+    host, _, port = value.rpartition(':')
+    if not host:
+        return (value, DEFAULT_PORT)
+    return (host, int(port))
+
+
+def format_address(address):
+    return f'{address[0]}:{address[1]}'
+
+
+def send_message(sock, message):
+    data = pickle.dumps(message, protocol=pickle.HIGHEST_PROTOCOL)
+    sock.sendall(HEADER.pack(len(data)) + data)
+
+
+def recv_exact(sock, size):
+    chunks = []
+    while size:
+        chunk = sock.recv(min(size, 1 << 20))
+        if not chunk:
+            raise ConnectionError('connection closed')
+        chunks.append(chunk)
+        size -= len(chunk)
+    return b''.join(chunks)
+
+
+def recv_message(sock):
+    (size,) = HEADER.unpack(recv_exact(sock, HEADER.size))
+    return pickle.loads(recv_exact(sock, size))
+
+
+# The peer closed the connection (it does not send anything while a test runs)
+def is_closed(sock):
+    readable, _, _ = select.select([sock], [], [], 0)
+    return bool(readable) and not sock.recv(1, socket.MSG_PEEK)
+
+
+def get_jobs(address):
+    with socket.create_connection(address, timeout=CONNECT_TIMEOUT) as sock:
+        send_message(sock, ('hello',))
+        return recv_message(sock)[1]
+
+
+# Files of a worker daemon by their digest
+class FileStore:
+    def __init__(self, root):
+        self.root = root
+
+    def get_path(self, digest):
+        return os.path.join(self.root, digest.hex())
+
+    def get_missing(self, digests):
+        return [d for d in set(digests) if not os.path.exists(self.get_path(d))]
+
+    def add(self, digest, data):
+        if hash_data(data) != digest:
+            raise ValueError('content does not match the digest')
+        # connections add files concurrently, a file appears only when it is complete
+        with tempfile.NamedTemporaryFile(mode='wb', dir=self.root, delete=False) as f:
+            f.write(data)
+        os.chmod(f.name, 0o755)
+        os.replace(f.name, self.get_path(digest))
+
+
+class WorkerRequestHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        try:
+            while True:
+                message = recv_message(self.request)
+                if message[0] == 'hello':
+                    send_message(self.request, ('hello', self.server.jobs))
+                elif message[0] == 'test':
+                    self.run_test(*message[1:])
+        except (ConnectionError, OSError, ValueError, pickle.UnpicklingError):
+            pass
+
+    def run_test(self, name, data, files, script):
+        store = self.server.store
+        send_message(self.request, ('missing', store.get_missing(list(files.values()) + [script])))
+        reply = recv_message(self.request)
+        for digest, content in reply[1].items():
+            store.add(digest, content)
+
+        folder = tempfile.mkdtemp(prefix='cvise-worker-', dir=self.server.root)
+        try:
+            with open(os.path.join(folder, name), 'wb') as f:
+                f.write(data)
+            # the files are private copies (reflinks where possible), a test that
+            # changes one does not change the store
+            for other, digest in files.items():
+                link_file(store.get_path(digest), os.path.join(folder, other))
+            with self.server.slots:
+                returncode = self.run_process(store.get_path(script), folder)
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+        if returncode is not None:
+            send_message(self.request, ('result', returncode))
+
+    # Return the exit code of the test, or None if the client went away meanwhile
+    def run_process(self, script, folder):
+        # the script is run by the shell like a local test
+        proc = subprocess.Popen(shlex.quote(script), shell=True, cwd=folder, stdin=subprocess.DEVNULL,
+                                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, start_new_session=True)
+        try:
+            while True:
+                try:
+                    return proc.wait(timeout=POLL_INTERVAL)
+                except subprocess.TimeoutExpired:
+                    # the test timed out or was cancelled on the client
+                    if is_closed(self.request):
+                        return None
+        finally:
+            kill_process_group(proc.pid)
+            proc.wait()
+
+
+# The worker daemon; every connection is served by its own thread and at most jobs
+# tests run at the same time
+class WorkerServer(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+    def __init__(self, address, jobs, tmp_dir=None):
+        super().__init__(address, WorkerRequestHandler)
+        self.jobs = jobs
+        self.slots = threading.Semaphore(jobs)
+        self.root = tempfile.mkdtemp(prefix='cvise-worker-', dir=tmp_dir)
+        os.mkdir(os.path.join(self.root, 'files'))
+        self.store = FileStore(os.path.join(self.root, 'files'))
+
+    def server_close(self):
+        super().server_close()
+        shutil.rmtree(self.root, ignore_errors=True)
+
+
+# Connections of a test worker process to the daemons, and the digests of the
+# files it sent, by inode and modification time
+_connections = {}
+_digests = {}
+
+
+def get_digest(path):
+    stat = os.stat(path)
+    key = (stat.st_dev, stat.st_ino, stat.st_size, stat.st_mtime_ns)
+    if key not in _digests:
+        with open(path, 'rb') as f:
+            _digests[key] = hash_data(f.read())
+    return _digests[key]
+
+
+def read_files(paths):
+    content = {}
+    for path in paths:
+        with open(path, 'rb') as f:
+            data = f.read()
+        content[hash_data(data)] = data
+    return content
+
+
+def get_connection(address):
+    if address not in _connections:
+        try:
+            _connections[address] = socket.create_connection(address, timeout=CONNECT_TIMEOUT)
+        except OSError as e:
+            raise RemoteWorkerError(format_address(address), str(e))
+        _connections[address].settimeout(None)
+    return _connections[address]
+
+
+def close_connection(address):
+    sock = _connections.pop(address, None)
+    if sock:
+        sock.close()
+
+
+# Wait for the result of the test, a cancelled job closes the connection, which
+# makes the daemon kill the test
+def wait_for_result(address, sock):
+    while not select.select([sock], [], [], POLL_INTERVAL)[0]:
+        if is_cancelled():
+            close_connection(address)
+            raise JobCancelledError()
+    return recv_message(sock)[1]
+
+
+# Run the interestingness test on the files in folder in the daemon at address;
+# test_case is the file that differs from one variant to the next
+def run_remote_test(address, folder, test_case, test_script):
+    others = [e.name for e in os.scandir(folder) if e.is_file() and e.name != test_case]
+    with open(os.path.join(folder, test_case), 'rb') as f:
+        data = f.read()
+    files = {name: get_digest(os.path.join(folder, name)) for name in others}
+    script = get_digest(test_script)
+    paths = {digest: os.path.join(folder, name) for name, digest in files.items()}
+    paths[script] = test_script
+
+    # a connection that broke since the last test is opened again once
+    for attempt in range(2):
+        sock = get_connection(address)
+        try:
+            send_message(sock, ('test', test_case, data, files, script))
+            missing = recv_message(sock)[1]
+            send_message(sock, ('files', read_files(paths[d] for d in missing)))
+            return wait_for_result(address, sock)
+        except (ConnectionError, OSError) as e:
+            close_connection(address)
+            if attempt:
+                raise RemoteWorkerError(format_address(address), str(e))
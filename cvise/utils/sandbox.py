@@ -0,0 +1,95 @@
+import os
+import shutil
+import tempfile
+
+try:
+    import fcntl
+except ImportError:
+    fcntl = None
+
+# ioctl request number of FICLONE (see linux/fs.h)
+FICLONE = 0x40049409
+TMPFS_DIR = '/dev/shm'
+
+
+def get_tmp_dir(tmpfs):
+    if tmpfs and os.path.isdir(TMPFS_DIR):
+        return TMPFS_DIR
+    return None
+
+
+def reflink(src, dst):
+    if fcntl is None:
+        raise OSError('reflink is not supported')
+    with open(src, 'rb') as src_file, open(dst, 'wb') as dst_file:
+        fcntl.ioctl(dst_file.fileno(), FICLONE, src_file.fileno())
+
+
+# Stage src as dst without copying data if possible. A reflink is a private
+# copy-on-write clone; a hard link is not used, as a test that writes to the
+# file would change the original.
+def link_file(src, dst):
+    try:
+        reflink(src, dst)
+        shutil.copystat(src, dst)
+        return
+    except OSError:
+        if os.path.exists(dst):
+            os.unlink(dst)
+
+    shutil.copy2(src, dst)
+
+
+def is_staged(src, dst):
+    try:
+        if os.path.samefile(src, dst):
+            return True
+        src_stat = os.stat(src)
+        dst_stat = os.stat(dst)
+    except OSError:
+        return False
+    return src_stat.st_size == dst_stat.st_size and src_stat.st_mtime_ns == dst_stat.st_mtime_ns
+
+
+# Make folder contain a fresh copy of test_case and the additional_files. The folder
+# can be reused from a previous variant: additional files that are still up to date
+# are kept, everything else (including files created by the test) is removed.
+def stage_files(folder, test_case, additional_files):
+    additional = {os.path.basename(f): f for f in additional_files}
+    with os.scandir(folder) as entries:
+        for entry in entries:
+            if entry.name in additional and entry.is_file(follow_symlinks=False):
+                if is_staged(additional[entry.name], entry.path):
+                    del additional[entry.name]
+                    continue
+            if entry.is_dir(follow_symlinks=False):
+                shutil.rmtree(entry.path, ignore_errors=True)
+            else:
+                os.unlink(entry.path)
+
+    # the transformed file is always a private copy
+    if test_case is not None:
+        shutil.copy(test_case, folder)
+
+    for name, f in additional.items():
+        link_file(f, os.path.join(folder, name))
+
+
+# Reusable test folders of a reduction, created on demand inside root
+class SandboxPool:
+
+    def __init__(self, root, prefix):
+        self.root = root
+        self.prefix = prefix
+        self.free_folders = []
+
+    def acquire(self):
+        if self.free_folders:
+            return self.free_folders.pop()
+        return tempfile.mkdtemp(prefix=self.prefix, dir=self.root)
+
+    def release(self, folder, reusable):
+        if reusable:
+            self.free_folders.append(folder)
+        else:
+            shutil.rmtree(folder, ignore_errors=True)
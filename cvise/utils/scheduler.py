@@ -0,0 +1,379 @@
+from collections import deque
+from concurrent.futures import CancelledError, TimeoutError
+from contextlib import contextmanager
+import multiprocessing
+from multiprocessing.connection import wait
+import os
+import signal
+import time
+
+from cvise.utils.process import ProcessGroups
+
+# Event-driven scheduler for persistent test workers. There is no background thread and
+# no polling: the main loop blocks on the pipes and sentinels of the busy workers
+# until a result arrives, a worker dies or the nearest timeout expires.
+
+
+class WorkerDiedError(Exception):
+    pass
+
+
+class JobCancelledError(Exception):
+    pass
+
+
+# Cancellation is delivered to a worker as a signal where supported (POSIX). The id
+# of the cancelled job is shared memory, so a late signal cannot cancel the next job.
+CANCEL_SIGNAL = getattr(signal, 'SIGUSR1', None)
+running_job = None
+cancelled_job = None
+process_groups = None
+server_groups = None
+starting_process = False
+kill_pending = False
+
+
+def is_cancelled():
+    return running_job is not None and running_job == cancelled_job.value
+
+
+# The process groups of the processes the jobs of this worker start
+def get_process_groups():
+    return process_groups
+
+
+# The process groups of processes that serve all jobs of this worker (persistent
+# test servers); they are killed with the worker. A server is only killed with a
+# cancelled job while it serves the job, when it is in the groups of the job too.
+def get_server_groups():
+    return server_groups
+
+
+# The handler does not raise: an exception at an arbitrary point could break the
+# state of the worker. It kills the processes of the job, so that the job finishes.
+def cancel_handler(signum, frame):
+    global kill_pending
+    if is_cancelled():
+        if starting_process:
+            kill_pending = True
+        else:
+            process_groups.kill()
+
+
+# Jobs start their processes inside this guard: a cancelled job cannot start
+# a new one, and a cancellation arriving meanwhile is handled right after.
+@contextmanager
+def process_start_guard():
+    global starting_process, kill_pending
+    starting_process = True
+    try:
+        if is_cancelled():
+            raise JobCancelledError()
+        yield
+    finally:
+        starting_process = False
+        if kill_pending:
+            kill_pending = False
+            process_groups.kill()
+
+
+def run_job(job_id, function, args):
+    global running_job
+    running_job = job_id
+    try:
+        return (True, function(*args))
+    except Exception as e:
+        return (False, e)
+    finally:
+        running_job = None
+
+
+def worker_main(conn, cancelled, groups, servers, initializer, initargs):
+    global cancelled_job, process_groups, server_groups
+    cancelled_job = cancelled
+    process_groups = groups
+    server_groups = servers
+    try:
+        if CANCEL_SIGNAL:
+            signal.signal(CANCEL_SIGNAL, cancel_handler)
+            signal.pthread_sigmask(signal.SIG_UNBLOCK, {CANCEL_SIGNAL})
+        if initializer:
+            initializer(*initargs)
+        while True:
+            try:
+                task = conn.recv()
+            except EOFError:
+                break
+            # forked workers share the parent ends of the pipes, so stopping needs an explicit message
+            if task is None:
+                break
+            conn.send(run_job(*task))
+    except KeyboardInterrupt:
+        # the main process handles the interrupt and stops the workers; the
+        # processes of the job run in their own session and do not get it
+        process_groups.kill()
+    finally:
+        server_groups.kill()
+
+
+class Worker:
+    def __init__(self, initializer, initargs):
+        self.conn, child_conn = multiprocessing.Pipe()
+        self.cancelled_job = multiprocessing.RawValue('q', -1)
+        self.process_groups = ProcessGroups()
+        self.server_groups = ProcessGroups()
+        self.process = multiprocessing.Process(target=worker_main,
+                                               args=(child_conn, self.cancelled_job, self.process_groups,
+                                                     self.server_groups, initializer, initargs),
+                                               daemon=True)
+        # the worker unblocks the cancel signal once its handler is installed
+        if CANCEL_SIGNAL:
+            signal.pthread_sigmask(signal.SIG_BLOCK, {CANCEL_SIGNAL})
+        try:
+            self.process.start()
+        finally:
+            if CANCEL_SIGNAL:
+                signal.pthread_sigmask(signal.SIG_UNBLOCK, {CANCEL_SIGNAL})
+        child_conn.close()
+        self.job = None
+
+    def kill(self):
+        self.process.kill()
+        self.process.join()
+        # test processes of the job would outlive the worker otherwise
+        self.process_groups.kill()
+        self.server_groups.kill()
+        self.conn.close()
+
+
+# A scheduled task, with the subset of the concurrent.futures.Future interface
+# the test manager uses. Blocking calls drive the event loop of the scheduler.
+# A job can continue in another stage: the continuation gets the result and
+# returns the next (function, args, stage, timeout), or None to finish.
+class Job:
+    PENDING = 'PENDING'
+    RUNNING = 'RUNNING'
+    CANCELLED = 'CANCELLED'
+    FINISHED = 'FINISHED'
+
+    def __init__(self, scheduler, job_id, function, args, timeout, stage, continuation):
+        self.scheduler = scheduler
+        self.job_id = job_id
+        self.function = function
+        self.args = args
+        self.timeout = timeout
+        self.stage = stage
+        self.continuation = continuation
+        self.deadline = None
+        self.start_time = None
+        self.state = self.PENDING
+        self._result = None
+        self._exception = None
+
+    def done(self):
+        return self.state in (self.CANCELLED, self.FINISHED)
+
+    def cancelled(self):
+        return self.state == self.CANCELLED
+
+    def cancel(self):
+        if self.state == self.FINISHED:
+            return False
+        if self.state != self.CANCELLED:
+            self.scheduler.cancel(self)
+            self.state = self.CANCELLED
+        return True
+
+    def exception(self):
+        self.scheduler.wait([self])
+        if self.cancelled():
+            raise CancelledError()
+        return self._exception
+
+    def result(self):
+        exception = self.exception()
+        if exception:
+            raise exception
+        return self._result
+
+    def finish(self, result=None, exception=None):
+        self.state = self.FINISHED
+        self._result = result
+        self._exception = exception
+
+
+# Workers of a stage only run jobs of the stage
+class Stage:
+    def __init__(self, max_workers):
+        self.max_workers = max_workers
+        self.idle = []
+        self.busy = []
+        self.draining = []
+        self.pending = deque()
+
+
+class Scheduler:
+    DEFAULT_STAGE = 'default'
+
+    def __init__(self, max_workers, initializer=None, initargs=()):
+        self.initializer = initializer
+        self.initargs = initargs
+        self.stages = {}
+        self.job_count = 0
+        self.add_stage(self.DEFAULT_STAGE, max_workers)
+
+    def add_stage(self, name, max_workers):
+        stage = Stage(max_workers)
+        stage.idle = [self.create_worker(stage) for _ in range(max_workers)]
+        self.stages[name] = stage
+
+    def create_worker(self, stage):
+        worker = Worker(self.initializer, self.initargs)
+        worker.stage = stage
+        return worker
+
+    def get_pids(self):
+        return [w.process.pid for stage in self.stages.values() for w in stage.idle + stage.busy + stage.draining]
+
+    def get_active_workers(self):
+        return [w for stage in self.stages.values() for w in stage.busy + stage.draining]
+
+    def schedule(self, function, args=(), timeout=None, stage=DEFAULT_STAGE, continuation=None):
+        self.job_count += 1
+        job = Job(self, self.job_count, function, args, timeout, stage, continuation)
+        self.stages[stage].pending.append(job)
+        self.dispatch()
+        return job
+
+    def continue_job(self, job, result):
+        task = job.continuation(result)
+        if task is None:
+            job.finish(result=result)
+            return
+        self.job_count += 1
+        job.job_id = self.job_count
+        (job.function, job.args, job.stage, job.timeout) = task
+        job.continuation = None
+        job.deadline = None
+        job.state = Job.PENDING
+        self.stages[job.stage].pending.append(job)
+
+    def dispatch(self):
+        for stage in self.stages.values():
+            while stage.pending and len(stage.busy) < stage.max_workers:
+                if stage.idle:
+                    worker = stage.idle.pop()
+                elif len(stage.busy) + len(stage.draining) < stage.max_workers:
+                    worker = self.create_worker(stage)
+                else:
+                    break
+                job = stage.pending.popleft()
+                worker.conn.send((job.job_id, job.function, job.args))
+                job.state = Job.RUNNING
+                job.start_time = time.monotonic()
+                if job.timeout:
+                    job.deadline = job.start_time + job.timeout
+                worker.job = job
+                stage.busy.append(worker)
+
+    def cancel(self, job):
+        stage = self.stages[job.stage]
+        if job.state == Job.PENDING:
+            stage.pending.remove(job)
+        elif job.state == Job.RUNNING:
+            worker = next(w for w in stage.busy if w.job is job)
+            stage.busy.remove(worker)
+            if CANCEL_SIGNAL:
+                # forking a replacement costs more than a short test: the worker
+                # kills the processes of the job, which then finishes quickly
+                worker.cancelled_job.value = job.job_id
+                os.kill(worker.process.pid, CANCEL_SIGNAL)
+                stage.draining.append(worker)
+            else:
+                worker.kill()
+                self.dispatch()
+
+    @staticmethod
+    def remove_worker(worker):
+        if worker in worker.stage.busy:
+            worker.stage.busy.remove(worker)
+            return True
+        worker.stage.draining.remove(worker)
+        return False
+
+    def process_events(self, timeout):
+        objects = {}
+        for worker in self.get_active_workers():
+            objects[worker.conn] = worker
+            objects[worker.process.sentinel] = worker
+
+        finished = set()
+        for obj in wait(list(objects), timeout):
+            worker = objects[obj]
+            if worker in finished:
+                continue
+            finished.add(worker)
+            active = self.remove_worker(worker)
+            try:
+                success, value = worker.conn.recv()
+            except (EOFError, OSError):
+                worker.kill()
+                if active:
+                    worker.job.finish(exception=WorkerDiedError(f'test worker died with exit code {worker.process.exitcode}'))
+                continue
+            if active:
+                if not success:
+                    worker.job.finish(exception=value)
+                elif worker.job.continuation:
+                    self.continue_job(worker.job, value)
+                else:
+                    worker.job.finish(result=value)
+            worker.job = None
+            worker.stage.idle.append(worker)
+
+        now = time.monotonic()
+        for worker in self.get_active_workers():
+            if worker.job.deadline is not None and worker.job.deadline <= now:
+                worker.kill()
+                if self.remove_worker(worker):
+                    worker.job.finish(exception=TimeoutError())
+        self.dispatch()
+
+    def get_event_timeout(self):
+        deadlines = [w.job.deadline for w in self.get_active_workers() if w.job.deadline is not None]
+        return max(0, min(deadlines) - time.monotonic()) if deadlines else None
+
+    # Process events until one of the jobs (or all of them) is done
+    def wait(self, jobs, return_when_all=True):
+        while True:
+            done = [job.done() for job in jobs]
+            if all(done) or (not return_when_all and any(done)):
+                return
+            self.process_events(self.get_event_timeout())
+
+    # Wait until the workers of cancelled jobs have killed their test processes
+    def drain(self):
+        while any(stage.draining for stage in self.stages.values()):
+            self.process_events(self.get_event_timeout())
+
+    def stop(self):
+        for stage in self.stages.values():
+            for job in stage.pending:
+                job.state = Job.CANCELLED
+            stage.pending.clear()
+            for worker in stage.busy:
+                worker.job.state = Job.CANCELLED
+                worker.kill()
+            for worker in stage.draining:
+                worker.kill()
+            for worker in stage.idle:
+                try:
+                    worker.conn.send(None)
+                except OSError:
+                    # the worker is gone, e.g. after an interrupt from the terminal
+                    pass
+                worker.process.join()
+                worker.conn.close()
+            stage.busy = []
+            stage.draining = []
+            stage.idle = []
@@ -1,34 +1,103 @@
+from bisect import bisect_left, insort
+from collections import deque
+import math
 import time
 
+import psutil
+
+try:
+    import resource
+except ImportError:
+    resource = None
+
+
+# CPU time of C-Vise and its finished child processes (wall time where it is not available).
+# The running processes pids (e.g. test workers) are counted with their finished children.
+def get_cpu_seconds(pids=()):
+    if resource is None:
+        return time.monotonic()
+    seconds = 0
+    for who in (resource.RUSAGE_SELF, resource.RUSAGE_CHILDREN):
+        usage = resource.getrusage(who)
+        seconds += usage.ru_utime + usage.ru_stime
+    for pid in pids:
+        try:
+            times = psutil.Process(pid).cpu_times()
+        except psutil.Error:
+            continue
+        seconds += times.user + times.system + getattr(times, 'children_user', 0) + getattr(times, 'children_system', 0)
+    return seconds
+
 
 class SinglePassStatistic:
+    # weight of the last run in the gain
+    GAIN_WEIGHT = 0.5
+    MIN_SECONDS = 0.01
+
     def __init__(self, pass_name):
         self.pass_name = pass_name
         self.total_seconds = 0
         self.worked = 0
         self.failed = 0
+        self.timeouts = 0
         self.totally_executed = 0
+        self.runs = 0
+        self.useful_runs = 0
+        self.removed_bytes = 0
+        self.cpu_seconds = 0
+        # bytes removed per CPU second, weighted towards the recent runs
+        self.gain = None
+        # number of the last runs that removed nothing
+        self.idle_runs = 0
+
+    def add_run(self, removed_bytes, cpu_seconds):
+        self.runs += 1
+        if removed_bytes > 0:
+            self.useful_runs += 1
+        self.removed_bytes += removed_bytes
+        self.cpu_seconds += cpu_seconds
+        gain = max(removed_bytes, 0) / max(cpu_seconds, self.MIN_SECONDS)
+        if self.gain is not None:
+            gain = self.GAIN_WEIGHT * gain + (1 - self.GAIN_WEIGHT) * self.gain
+        self.gain = gain
+        self.idle_runs = 0 if removed_bytes > 0 else self.idle_runs + 1
 
 
 class PassStatistic:
     def __init__(self):
         self.stats = {}
         self.last_pass_start = None
+        self.last_pass_cpu_seconds = None
         self.last_pass_name = None
 
-    def start(self, pass_):
+    def get(self, pass_):
         pass_name = repr(pass_)
         if pass_name not in self.stats:
             self.stats[pass_name] = SinglePassStatistic(pass_name)
+        return self.stats[pass_name]
+
+    # Expectations for a pass that has not run yet, e.g. from earlier reductions
+    def set_prior(self, pass_, gain, idle_runs):
+        stat = self.get(pass_)
+        stat.gain = gain
+        stat.idle_runs = idle_runs
+
+    # The workers are the running processes whose CPU time counts for the pass
+    def start(self, pass_, workers=()):
+        pass_name = repr(pass_)
+        self.get(pass_)
         assert not self.last_pass_name
         self.last_pass_name = pass_name
         self.last_pass_start = time.monotonic()
+        self.last_pass_cpu_seconds = get_cpu_seconds(workers)
 
-    def stop(self, pass_):
+    def stop(self, pass_, removed_bytes=0, workers=()):
         pass_name = repr(pass_)
         assert pass_name == self.last_pass_name
         self.stats[pass_name].total_seconds += time.monotonic() - self.last_pass_start
+        self.stats[pass_name].add_run(removed_bytes, get_cpu_seconds(workers) - self.last_pass_cpu_seconds)
         self.last_pass_start = None
+        self.last_pass_cpu_seconds = None
         self.last_pass_name = None
 
     def add_executed(self, pass_):
@@ -43,6 +112,10 @@ class PassStatistic:
         pass_name = repr(pass_)
         self.stats[pass_name].failed += 1
 
+    def add_timeout(self, pass_):
+        pass_name = repr(pass_)
+        self.stats[pass_name].timeouts += 1
+
     @property
     def sorted_results(self):
         def sort_statistics(item):
@@ -50,3 +123,33 @@ class PassStatistic:
             return (-pass_data.total_seconds, pass_name)
 
         return sorted(self.stats.items(), key=sort_statistics)
+
+
+# Timeout of the interestingness test derived from the runtimes of the recent
+# interesting variants: a multiple of a high percentile, within [FLOOR, maximum].
+# Failing tests are not counted, they often stop early. The window is kept sorted
+# as well, so that a new runtime does not sort it again.
+class AdaptiveTimeout:
+    FACTOR = 10
+    PERCENTILE = 0.99
+    FLOOR = 10
+    WINDOW = 1000
+
+    def __init__(self, maximum):
+        self.maximum = maximum
+        self.runtimes = deque()
+        self.sorted_runtimes = []
+        self.value = maximum
+
+    def add(self, seconds):
+        if len(self.runtimes) == self.WINDOW:
+            del self.sorted_runtimes[bisect_left(self.sorted_runtimes, self.runtimes.popleft())]
+        self.runtimes.append(seconds)
+        insort(self.sorted_runtimes, seconds)
+        percentile = self.sorted_runtimes[math.ceil(self.PERCENTILE * len(self.sorted_runtimes)) - 1]
+        self.value = min(max(self.FACTOR * percentile, self.FLOOR), self.maximum)
+
+    # A test that timed out ran for at least the timeout; if that is not rare, the
+    # timeout grows
+    def add_timeout(self, seconds):
+        self.add(seconds)
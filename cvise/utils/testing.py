@@ -1,9 +1,11 @@
-from concurrent.futures import FIRST_COMPLETED, TimeoutError, wait
+from collections import Counter
+from concurrent.futures import TimeoutError
+import copy
 import difflib
 import filecmp
+import functools
 import logging
 import math
-from multiprocessing import Manager
 import os
 import os.path
 import platform
@@ -11,23 +13,33 @@ import shutil
 import subprocess
 import sys
 import tempfile
-import traceback
+import time
 
 from cvise.cvise import CVise
-from cvise.passes.abstract import PassResult, ProcessEventNotifier, ProcessEventType
+from cvise.passes.abstract import PassResult, ProcessEventNotifier
+from cvise.utils.cache import hash_context, hash_data, hash_file, PassCache, ResultCache, ResultStore
+from cvise.utils.checkpoint import Checkpoint, PassProgress
 from cvise.utils.error import FolderInPathTestCaseError
 from cvise.utils.error import InsaneTestCaseError
+from cvise.utils.error import InterestingnessServerError
+from cvise.utils.error import InvalidCheckpointError
 from cvise.utils.error import InvalidInterestingnessTestError
 from cvise.utils.error import InvalidTestCaseError
 from cvise.utils.error import PassBugError
 from cvise.utils.error import ZeroSizeError
-from cvise.utils.misc import is_readable_file
+from cvise.utils.merge import merge_variants
+from cvise.utils.misc import count_lines, get_line_delta, is_readable_file, replace_file
+from cvise.utils.parallelism import AutoParallelism
+from cvise.utils.process import get_descendants_memory
 from cvise.utils.readkey import KeyLogger
-import pebble
-import psutil
+from cvise.utils.sandbox import get_tmp_dir, SandboxPool, stage_files
+from cvise.utils.scheduler import Scheduler
+from cvise.utils.statistics import AdaptiveTimeout
+from cvise.utils.testserver import InterestingnessServer
+from cvise.utils.worker import (apply_delta, init_worker, is_tested, run_merged_variant, run_test, run_variant,
+                                speculate_new, state_delta, test_variant, transform_variant)
+from cvise.utils.worker import write_snapshot
 
-# change default Pebble sleep unit for faster response
-pebble.common.SLEEP_UNIT = 0.01
 MAX_PASS_INCREASEMENT_THRESHOLD = 3
 
 
@@ -41,7 +53,7 @@ def rmfolder(name):
 
 class TestEnvironment:
     def __init__(self, state, order, test_script, folder, test_case,
-                 additional_files, transform, pid_queue=None):
+                 additional_files):
         self.test_case = None
         self.additional_files = set()
         self.state = state
@@ -50,21 +62,25 @@ class TestEnvironment:
         self.test_script = test_script
         self.exitcode = None
         self.result = None
+        self.outcome = None
+        self.digest = None
+        self.test_seconds = None
         self.order = order
-        self.transform = transform
-        self.pid_queue = pid_queue
+        # set for the variants of a FileLane
+        self.base_state = None
+        self.versions = None
+        self.retest = False
         self.copy_files(test_case, additional_files)
-        self.pwd = os.getcwd()
 
     def copy_files(self, test_case, additional_files):
         if test_case is not None:
             self.test_case = os.path.basename(test_case)
-            shutil.copy(test_case, self.folder)
             self.base_size = os.path.getsize(test_case)
 
         for f in additional_files:
             self.additional_files.add(os.path.basename(f))
-            shutil.copy(f, self.folder)
+
+        stage_files(self.folder, test_case, additional_files)
 
     @property
     def size_improvement(self):
@@ -94,55 +110,95 @@ class TestEnvironment:
 
         shutil.copy(self.test_script, dst)
 
-    def run(self):
-        try:
-            # transform by state
-            (result, self.state) = self.transform(self.test_case_path, self.state,
-                                                  ProcessEventNotifier(self.pid_queue))
-            self.result = result
-            if self.result != PassResult.OK:
-                return self
-
-            # run test script
-            self.exitcode = self.run_test(False)
-            return self
-        except OSError:
-            # this can happen when we clean up temporary files for cancelled processes
-            return self
-        except Exception as e:
-            print('Unexpected TestEnvironment::run failure: ' + str(e))
-            traceback.print_exc()
-            return self
+    def set_outcome(self, outcome, base_state):
+        self.outcome = outcome
+        (self.result, self.exitcode, delta, self.digest, self.test_seconds) = outcome
+        self.state = apply_delta(base_state, delta)
 
     def run_test(self, verbose):
-        try:
-            os.chdir(self.folder)
-            stdout, stderr, returncode = ProcessEventNotifier(self.pid_queue).run_process(self.test_script, shell=True)
-            if verbose and returncode != 0:
-                logging.debug('stdout:\n' + stdout)
-                logging.debug('stderr:\n' + stderr)
-        finally:
-            os.chdir(self.pwd)
+        stdout, stderr, returncode = run_test(self.test_script, self.folder, ProcessEventNotifier(None))
+        if verbose and returncode != 0:
+            logging.debug('stdout:\n' + stdout)
+            logging.debug('stderr:\n' + stderr)
         return returncode
 
 
+# The next pass, started on the current test cases while the last tests of a pass
+# finish. Its first variants are tested into the result cache, and its initial state
+# is reused if the test cases are still the same when the pass starts. The next pass
+# takes over the jobs that are still running at the end of the pass.
+class Speculation:
+    def __init__(self, pass_, test_case, key, folder):
+        self.pass_ = pass_
+        self.test_case = test_case
+        self.key = key
+        self.folder = folder
+        self.future = None
+        # (pass, initial state, content of the test case after new)
+        self.result = None
+        self.snapshot = None
+        self.variants = {}
+
+
+# A test case that is reduced by the current pass at the same time as other test cases
+# (see TestManager.run_lanes). The lane has its own copy of the pass, as new may set
+# attributes of the pass.
+class FileLane:
+    def __init__(self, pass_, test_case):
+        self.pass_ = pass_
+        self.test_case = test_case
+        self.state = None
+        self.base_state = None
+        self.snapshot = None
+        # versions of the test cases the snapshot was written for
+        self.versions = None
+        self.futures = []
+        self.order = 1
+        self.success_count = 0
+        self.timeout_count = 0
+        self.starting_size = None
+        self.digest_before_pass = None
+        self.stopped = False
+
+
 class TestManager:
     GIVEUP_CONSTANT = 50000
     MAX_TIMEOUTS = 20
     MAX_CRASH_DIRS = 10
     MAX_EXTRA_DIRS = 25000
+    TRANSFORM_STAGE = 'transform'
     TEMP_PREFIX = 'cvise-'
+    CHECKPOINT_INTERVAL = 60
+    EXCHANGE_INTERVAL = 5
+    MAX_NEW_RESULTS = 10000
+    DEFAULT_TIMEOUT = 300
 
     def __init__(self, pass_statistic, test_script, timeout, save_temps, test_cases, parallel_tests,
                  no_cache, skip_key_off, silent_pass_bug, die_on_pass_bug, print_diff, max_improvement,
-                 no_give_up, also_interesting, start_with_pass, skip_after_n_transforms):
+                 no_give_up, also_interesting, start_with_pass, skip_after_n_transforms, tmpfs=False,
+                 transformers=0, cache_dir=None, checkpoint=None,
+                 cache_memory_limit=None, auto_parallel=False, exchange=None, speculate=True, parallel_files=1,
+                 remote_workers=None, test_server=False, adaptive_timeout=False):
         self.test_script = os.path.abspath(test_script)
         self.timeout = timeout
+        # the adaptive timeout is adapted to the runtimes of the tests, up to timeout
+        self.adaptive_timeout = AdaptiveTimeout(timeout or self.DEFAULT_TIMEOUT) if adaptive_timeout else None
         self.save_temps = save_temps
         self.pass_statistic = pass_statistic
         self.test_cases = set()
         self.test_cases_modes = {}
         self.parallel_tests = parallel_tests
+        # with auto_parallel, the number of parallel tests is adapted to the system load
+        self.parallelism = AutoParallelism(parallel_tests) if auto_parallel else None
+        self.transformers = transformers
+        # (address, jobs) of the worker daemons that run the tests; the variants are
+        # transformed locally
+        self.remote_workers = remote_workers
+        assert not remote_workers or transformers
+        # the interestingness test is started once per test worker (see testserver)
+        self.test_server = test_server
+        # number of test cases a pass reduces at the same time
+        self.parallel_files = parallel_files
         self.no_cache = no_cache
         self.skip_key_off = skip_key_off
         self.silent_pass_bug = silent_pass_bug
@@ -153,6 +209,9 @@ class TestManager:
         self.also_interesting = also_interesting
         self.start_with_pass = start_with_pass
         self.skip_after_n_transforms = skip_after_n_transforms
+        self.tmp_dir = get_tmp_dir(tmpfs)
+        if tmpfs and self.tmp_dir is None:
+            logging.warning('tmpfs is not available, using the default temporary directory')
 
         for test_case in test_cases:
             self.check_file_permissions(test_case, [os.F_OK, os.R_OK, os.W_OK], InvalidTestCaseError)
@@ -162,9 +221,37 @@ class TestManager:
             self.test_cases.add(fullpath)
             self.test_cases_modes[fullpath] = os.stat(fullpath).st_mode
 
+        # sizes and line counts of the test cases, updated incrementally on success
+        self.file_sizes = {}
+        self.line_counts = {}
+        # number of changes of each test case
+        self.versions = dict.fromkeys(self.test_cases, 0)
+        self.update_statistics()
         self.orig_total_file_size = self.total_file_size
-        self.cache = {}
+        self.cache = PassCache(cache_memory_limit)
+        store = ResultStore(cache_dir, self.test_script) if cache_dir and not no_cache else None
+        self.test_cache = ResultCache(store)
+        self.new_results = []
+        self.checkpoint_path = checkpoint
+        self.checkpoint = Checkpoint()
+        self.last_checkpoint = time.monotonic()
+        self.resume_progress = None
+        # snapshots of the other members of a portfolio
+        self.exchange = exchange
+        self.last_exchange = time.monotonic()
+        # the speculative variants are transformed and tested in one job
+        self.speculate = speculate and not remote_workers
+        self.speculation_pass = None
+        self.speculation = None
+        self.speculated = None
         self.root = None
+        # the test folders and the workers are shared by all passes; unchanged
+        # additional files stay staged
+        self.run_root = None
+        self.sandbox_pool = None
+        self.scheduler = None
+        self.snapshot = None
+        self.snapshot_count = 0
         if not self.is_valid_test(self.test_script):
             raise InvalidInterestingnessTestError(self.test_script)
 
@@ -174,13 +261,101 @@ class TestManager:
 
     def create_root(self):
         pass_name = str(self.current_pass).replace('::', '-')
-        self.root = tempfile.mkdtemp(prefix=f'{self.TEMP_PREFIX}{pass_name}-')
+        self.root = tempfile.mkdtemp(prefix=f'{self.TEMP_PREFIX}{pass_name}-', dir=self.tmp_dir)
         logging.debug('Creating pass root folder: %s' % self.root)
+        if self.run_root is None:
+            self.run_root = tempfile.mkdtemp(prefix=f'{self.TEMP_PREFIX}run-', dir=self.tmp_dir)
+            # with --save-temps every variant keeps its own folder
+            self.sandbox_pool = None if self.save_temps else SandboxPool(self.run_root, self.TEMP_PREFIX)
 
     def remove_root(self):
         if not self.save_temps:
             rmfolder(self.root)
 
+    # Stop the workers and remove the test folders at the end of the reduction
+    def close(self):
+        self.stop_workers()
+        if self.run_root and not self.save_temps:
+            rmfolder(self.run_root)
+        self.run_root = None
+        self.sandbox_pool = None
+
+    def start_workers(self):
+        self.test_cache.sync()
+        known_results = None if self.no_cache else self.test_cache.get_returncodes()
+        self.new_results = []
+        self.scheduler = Scheduler(self.parallel_tests, init_worker, (known_results, self.test_server))
+        if self.transformers:
+            self.scheduler.add_stage(self.TRANSFORM_STAGE, self.transformers)
+
+    def stop_workers(self):
+        self.test_cache.sync()
+        if self.scheduler:
+            self.scheduler.stop()
+            for speculation in (self.speculation, self.speculated):
+                if speculation:
+                    self.release_speculation(speculation)
+            self.speculation = None
+            self.speculated = None
+            self.scheduler = None
+
+    def resume(self, path):
+        self.checkpoint = Checkpoint.read(path)
+        if self.checkpoint.category not in CVise.CATEGORIES:
+            raise InvalidCheckpointError(path, 'no position in the pass group')
+        if set(self.checkpoint.test_cases) != self.test_cases:
+            raise InvalidCheckpointError(path, 'the test cases do not match')
+        for test_case, content in self.checkpoint.test_cases.items():
+            with open(test_case, 'wb') as f:
+                f.write(content)
+        self.update_statistics()
+        self.cache = self.checkpoint.pass_cache
+        self.pass_statistic.stats = self.checkpoint.pass_statistics
+        self.resume_progress = self.checkpoint.pass_progress
+        if self.checkpoint_path is None:
+            self.checkpoint_path = path
+
+    def set_position(self, category, index):
+        self.checkpoint.category = category
+        self.checkpoint.pass_index = index
+        self.checkpoint.pass_progress = None
+
+    def save_checkpoint(self, progress):
+        self.checkpoint.pass_progress = progress
+        if not self.checkpoint_path or time.monotonic() - self.last_checkpoint < self.CHECKPOINT_INTERVAL:
+            return
+        self.checkpoint.pass_statistics = self.pass_statistic.stats
+        self.checkpoint.pass_cache = self.cache
+        self.checkpoint.test_cases = {}
+        for test_case in self.test_cases:
+            with open(test_case, 'rb') as f:
+                self.checkpoint.test_cases[test_case] = f.read()
+        self.checkpoint.write(self.checkpoint_path)
+        self.last_checkpoint = time.monotonic()
+        logging.debug(f'checkpoint written to {self.checkpoint_path}')
+
+    # Publish the test cases for the other members of the portfolio and adopt
+    # a smaller snapshot of theirs
+    def exchange_snapshots(self):
+        self.last_exchange = time.monotonic()
+        self.exchange.publish(self.test_cases, self.total_file_size)
+        snapshot = self.exchange.get_smaller(self.test_cases, self.total_file_size)
+        if snapshot is None:
+            return
+        for test_case in self.test_cases:
+            replace_file(test_case, snapshot[os.path.basename(test_case)])
+            self.versions[test_case] += 1
+        self.update_statistics()
+        self.exchange.published_size = self.total_file_size
+        logging.info(f'adopted a snapshot of {self.total_file_size} bytes from the portfolio')
+
+    # A pass is abandoned once another member has a smaller snapshot
+    def is_outdated(self):
+        if time.monotonic() - self.last_exchange < self.EXCHANGE_INTERVAL:
+            return False
+        self.last_exchange = time.monotonic()
+        return self.exchange.find_smaller(self.test_cases, self.total_file_size) is not None
+
     def restore_mode(self):
         for test_case in self.test_cases:
             os.chmod(test_case, self.test_cases_modes[test_case])
@@ -194,28 +369,31 @@ class TestManager:
 
     @property
     def total_file_size(self):
-        return self.get_file_size(self.test_cases)
+        return sum(self.file_sizes.values())
 
     @property
     def sorted_test_cases(self):
-        return sorted(self.test_cases, key=os.path.getsize, reverse=True)
-
-    @staticmethod
-    def get_file_size(files):
-        return sum(os.path.getsize(f) for f in files)
+        return sorted(self.test_cases, key=self.file_sizes.get, reverse=True)
 
     @property
     def total_line_count(self):
-        return self.get_line_count(self.test_cases)
-
-    @staticmethod
-    def get_line_count(files):
-        lines = 0
-        for file in files:
-            if is_readable_file(file):
-                with open(file) as f:
-                    lines += len([line for line in f.readlines() if line and not line.isspace()])
-        return lines
+        return sum(count for count in self.line_counts.values() if count is not None)
+
+    # Recompute the statistics of the test cases from their content
+    def update_statistics(self, test_cases=None):
+        for test_case in test_cases or self.test_cases:
+            with open(test_case, 'rb') as f:
+                data = f.read()
+            self.file_sizes[test_case] = len(data)
+            # binary files have no lines
+            self.line_counts[test_case] = count_lines(data) if is_readable_file(test_case) else None
+
+    # Update the statistics of a test case whose content changed from old to new
+    def update_file_statistics(self, test_case, old, new):
+        self.versions[test_case] += 1
+        self.file_sizes[test_case] = len(new)
+        if self.line_counts[test_case] is not None:
+            self.line_counts[test_case] += get_line_delta(old, new)
 
     def backup_test_cases(self):
         for f in self.test_cases:
@@ -293,25 +471,61 @@ class TestManager:
 
         return ''.join(diffed_lines)
 
+    def get_timeout(self):
+        return self.adaptive_timeout.value if self.adaptive_timeout else self.timeout
+
+    def add_runtime(self, test_env):
+        if self.parallelism:
+            self.parallelism.add_finished()
+        # cached outcomes have no runtime
+        if self.adaptive_timeout and test_env.success and test_env.test_seconds is not None:
+            self.adaptive_timeout.add(test_env.test_seconds)
+
     def check_sanity(self, verbose=False):
         logging.debug('perform sanity check... ')
 
-        folder = tempfile.mkdtemp(prefix=f'{self.TEMP_PREFIX}sanity-')
-        test_env = TestEnvironment(None, 0, self.test_script, folder, None, self.test_cases, None)
+        folder = tempfile.mkdtemp(prefix=f'{self.TEMP_PREFIX}sanity-', dir=self.tmp_dir)
+        test_env = TestEnvironment(None, 0, self.test_script, folder, None, self.test_cases)
         logging.debug(f'sanity check tmpdir = {test_env.folder}')
 
-        returncode = test_env.run_test(verbose)
+        start = time.monotonic()
+        if self.test_server:
+            server = InterestingnessServer(self.test_script)
+            try:
+                returncode = server.run(test_env.folder)
+            except InterestingnessServerError:
+                returncode = None
+            server.stop()
+        else:
+            returncode = test_env.run_test(verbose)
+        if self.adaptive_timeout:
+            self.adaptive_timeout.add(time.monotonic() - start)
+            logging.info(f'test timeout set to {self.adaptive_timeout.value:.1f} s')
         if returncode == 0:
             rmfolder(folder)
             logging.debug('sanity check successful')
         else:
             if not self.save_temps:
                 rmfolder(folder)
-            raise InsaneTestCaseError(self.test_cases, self.test_script)
+            raise InsaneTestCaseError(self.test_cases, self.test_script, self.test_server)
+
+    def acquire_folder(self):
+        if self.sandbox_pool:
+            return self.sandbox_pool.acquire()
+        else:
+            return tempfile.mkdtemp(prefix=self.TEMP_PREFIX, dir=self.root)
 
     def release_folder(self, future):
         name = self.temporary_folders.pop(future)
-        if not self.save_temps:
+        self.environments.pop(future)
+        self.release_test_folder(name, future)
+
+    def release_test_folder(self, name, future):
+        if self.sandbox_pool:
+            # processes of a cancelled or timed out test might still use the folder
+            reusable = future.done() and not future.cancelled() and future.exception() is None
+            self.sandbox_pool.release(name, reusable)
+        elif not self.save_temps:
             rmfolder(name)
 
     def release_folders(self):
@@ -323,27 +537,6 @@ class TestManager:
     def log_key_event(cls, event):
         logging.info('****** %s ******' % event)
 
-    def kill_pid_queue(self):
-        active_pids = set()
-        while not self.pid_queue.empty():
-            event = self.pid_queue.get()
-            if event.type == ProcessEventType.FINISHED:
-                active_pids.discard(event.pid)
-            else:
-                active_pids.add(event.pid)
-        for pid in active_pids:
-            try:
-                process = psutil.Process(pid)
-                children = process.children(recursive=True)
-                children.append(process)
-                for child in children:
-                    try:
-                        child.terminate()
-                    except psutil.NoSuchProcess:
-                        pass
-            except psutil.NoSuchProcess:
-                pass
-
     def release_future(self, future):
         self.futures.remove(future)
         self.release_folder(future)
@@ -359,17 +552,20 @@ class TestManager:
         quit_loop = False
         new_futures = set()
         for future in self.futures:
-            # all items after first successfull (or STOP) should be cancelled
+            # all items after first successfull (or STOP) should be cancelled,
+            # finished ones are kept as they can be merged with the success
             if quit_loop:
-                future.cancel()
+                if future.done():
+                    new_futures.add(future)
+                else:
+                    future.cancel()
                 continue
 
             if future.done():
                 if future.exception():
                     if type(future.exception()) is TimeoutError:
                         self.timeout_count += 1
-                        logging.warning('Test timed out.')
-                        self.save_extra_dir(self.temporary_folders[future])
+                        self.record_timeout(future)
                         if self.timeout_count >= self.MAX_TIMEOUTS:
                             logging.warning('Maximum number of timeout were reached: %d' % self.MAX_TIMEOUTS)
                             quit_loop = True
@@ -377,36 +573,11 @@ class TestManager:
                     else:
                         raise future.exception()
 
-                test_env = future.result()
-                if test_env.success:
-                    if (self.max_improvement is not None and
-                            test_env.size_improvement > self.max_improvement):
-                        logging.debug(f'Too large improvement: {test_env.size_improvement} B')
-                    else:
-                        # Report bug if transform did not change the file
-                        if filecmp.cmp(self.current_test_case, test_env.test_case_path):
-                            if not self.silent_pass_bug:
-                                if not self.report_pass_bug(test_env, 'pass failed to modify the variant'):
-                                    quit_loop = True
-                        else:
-                            quit_loop = True
-                            new_futures.add(future)
-                else:
-                    self.pass_statistic.add_failure(self.current_pass)
-                    if test_env.result == PassResult.OK:
-                        assert test_env.exitcode
-                        if (self.also_interesting is not None and
-                                test_env.exitcode == self.also_interesting):
-                            self.save_extra_dir(test_env.test_case_path)
-                    elif test_env.result == PassResult.STOP:
-                        quit_loop = True
-                    elif test_env.result == PassResult.ERROR:
-                        if not self.silent_pass_bug:
-                            self.report_pass_bug(test_env, 'pass error')
-                            quit_loop = True
-                    if not self.no_give_up and test_env.order > self.GIVEUP_CONSTANT:
-                        self.report_pass_bug(test_env, 'pass got stuck')
-                        quit_loop = True
+                test_env = self.get_test_env(future)
+                success, stop = self.check_outcome(test_env, self.current_test_case)
+                if success:
+                    new_futures.add(future)
+                quit_loop = quit_loop or stop
             else:
                 new_futures.add(future)
 
@@ -416,69 +587,676 @@ class TestManager:
 
         return quit_loop
 
+    def record_timeout(self, future):
+        self.pass_statistic.add_timeout(self.current_pass)
+        if self.adaptive_timeout:
+            self.adaptive_timeout.add_timeout(future.timeout)
+            logging.info(f'Test timed out at the adaptive timeout ({future.timeout:.1f} s), '
+                         f'the timeout is now {self.adaptive_timeout.value:.1f} s.')
+        else:
+            logging.warning(f'Test timed out ({future.timeout:.1f} s).')
+        self.save_extra_dir(self.temporary_folders[future])
+
+    # Check the outcome of a variant of test_case. Return whether it is a success
+    # to commit and whether no further variants should be tested.
+    def check_outcome(self, test_env, test_case):
+        if test_env.success:
+            if (self.max_improvement is not None and
+                    test_env.size_improvement > self.max_improvement):
+                logging.debug(f'Too large improvement: {test_env.size_improvement} B')
+                return (False, False)
+            # Report bug if transform did not change the file
+            if filecmp.cmp(test_case, test_env.test_case_path):
+                if not self.silent_pass_bug:
+                    if not self.report_pass_bug(test_env, 'pass failed to modify the variant'):
+                        return (False, True)
+                return (False, False)
+            return (True, True)
+
+        stop = False
+        self.pass_statistic.add_failure(self.current_pass)
+        if test_env.result == PassResult.OK:
+            assert test_env.exitcode
+            if (self.also_interesting is not None and
+                    test_env.exitcode == self.also_interesting):
+                self.save_extra_dir(test_env.test_case_path)
+        elif test_env.result == PassResult.STOP:
+            stop = True
+        elif test_env.result == PassResult.ERROR:
+            if not self.silent_pass_bug:
+                self.report_pass_bug(test_env, 'pass error')
+                stop = True
+        if not self.no_give_up and test_env.order > self.GIVEUP_CONSTANT:
+            self.report_pass_bug(test_env, 'pass got stuck')
+            stop = True
+        return (False, stop)
+
+    def get_test_env(self, future):
+        test_env = self.environments[future]
+        if test_env.outcome is None:
+            test_env.set_outcome(future.result(), self.base_state)
+            self.add_test_result(test_env)
+            self.add_runtime(test_env)
+        return test_env
+
+    def add_test_result(self, test_env):
+        if test_env.digest is None:
+            return
+        if test_env.test_seconds is None:
+            self.test_cache.add_hit(test_env.digest)
+        else:
+            self.test_cache.add(test_env.digest, test_env.exitcode, test_env.test_seconds)
+            self.new_results.append(test_env.digest)
+
+    def get_cache_context(self, test_case):
+        if self.no_cache:
+            return None
+        self.collect_speculation()
+        context = hash_context(test_case, self.test_cases ^ {test_case})
+        self.new_results += self.test_cache.sync()
+        return (context, self.test_cache.get_returncodes(self.new_results))
+
     def wait_for_first_success(self):
         for future in self.futures:
             try:
-                test_env = future.result()
+                test_env = self.get_test_env(future)
                 if test_env.success:
                     return test_env
             except TimeoutError:
                 pass
         return None
 
-    @classmethod
-    def terminate_all(cls, pool):
-        pool.stop()
-        pool.join()
+    def get_concurrent_successes(self, success_env):
+        envs = []
+        for future in self.futures:
+            if future.done() and not future.cancelled() and not future.exception():
+                test_env = self.get_test_env(future)
+                if test_env is not success_env and test_env.success:
+                    envs.append(test_env)
+        return sorted(envs, key=lambda env: env.order)
+
+    # Combine the success with other successful variants of the batch that edit
+    # other parts of the test case, the result is verified by one more test run.
+    # Only passes with independent edits merge, for the others the merged variant
+    # is rarely interesting.
+    def merge_successes(self, success_env):
+        if not self.current_pass.supports_merge:
+            return success_env
+        envs = self.get_concurrent_successes(success_env)
+        if not envs:
+            return success_env
+
+        variants = []
+        for test_env in [success_env] + envs:
+            with open(test_env.test_case_path, 'rb') as f:
+                variants.append(f.read())
+        with open(self.current_test_case, 'rb') as f:
+            original = f.read()
+        merged, count = merge_variants(original, variants)
+        if count < 2:
+            return success_env
+        if self.max_improvement is not None and len(original) - len(merged) > self.max_improvement:
+            return success_env
+
+        folder = self.acquire_folder()
+        merged_env = TestEnvironment(success_env.state, success_env.order, self.test_script, folder,
+                                     self.current_test_case, self.test_cases ^ {self.current_test_case})
+        with open(merged_env.test_case_path, 'wb') as f:
+            f.write(merged)
+        future = self.scheduler.schedule(run_merged_variant,
+                                         args=(folder, self.test_script, self.get_remote(merged_env.test_case)),
+                                         timeout=self.get_timeout())
+        self.temporary_folders[future] = folder
+        self.environments[future] = merged_env
+        self.futures.append(future)
+        self.pass_statistic.add_executed(self.current_pass)
+
+        try:
+            merged_env.exitcode = future.result()
+        except TimeoutError:
+            return success_env
+        if merged_env.exitcode != 0:
+            return success_env
+
+        merged_env.result = PassResult.OK
+        logging.debug(f'merged {count} successful variants')
+        return merged_env
+
+    def terminate_all(self):
+        for future in self.futures:
+            future.cancel()
+        self.scheduler.drain()
+
+    # Transformed variants wait for a free test worker, unless there is nothing to test
+    def get_test_task(self, folder, test_case, outcome):
+        if is_tested(outcome):
+            return None
+        return (test_variant, (folder, self.test_script, outcome, self.get_remote(test_case)), Scheduler.DEFAULT_STAGE,
+                self.get_timeout())
+
+    # The worker daemon with the fewest tests per job, and the test case that is sent
+    # for every variant
+    def get_remote(self, test_case):
+        if not self.remote_workers:
+            return None
+        stage = self.scheduler.stages[Scheduler.DEFAULT_STAGE]
+        jobs = [w.job for w in stage.busy] + list(stage.pending)
+        load = Counter(job.args[-1][0] for job in jobs
+                       if job.function in (test_variant, run_merged_variant) and job.args[-1])
+        address, _ = min(self.remote_workers, key=lambda worker: load[worker[0]] / worker[1])
+        return (address, test_case)
+
+    def schedule_variant(self, folder, test_case, snapshot, base_state, state):
+        delta = state_delta(base_state, state)
+        if not self.transformers:
+            return self.scheduler.schedule(run_variant, args=(snapshot, delta, folder, test_case,
+                                                              self.test_script), timeout=self.get_timeout())
+        return self.scheduler.schedule(transform_variant, args=(snapshot, delta, folder, test_case),
+                                       timeout=self.get_timeout(), stage=self.TRANSFORM_STAGE,
+                                       continuation=functools.partial(self.get_test_task, folder, test_case))
+
+    def get_test_memory(self):
+        workers = self.scheduler.stages[Scheduler.DEFAULT_STAGE].busy
+        if not workers:
+            return None
+        return get_descendants_memory([w.process.pid for w in workers]) / len(workers)
+
+    def tune_parallelism(self):
+        if self.parallelism.update(self.get_test_memory):
+            self.parallel_tests = self.parallelism.value
+            self.scheduler.stages[Scheduler.DEFAULT_STAGE].max_workers = self.parallel_tests
+            self.scheduler.dispatch()
+            logging.debug(f'number of parallel tests: {self.parallel_tests}')
+
+    # The versions identify the content of the test cases, without reading them
+    def get_snapshot_key(self):
+        return tuple(self.versions.values())
+
+    # Start the initial state of the next pass in a worker, its first variants
+    # follow once it is known
+    def start_speculation(self):
+        key = self.get_snapshot_key()
+        if self.speculation:
+            if self.speculation.key == key:
+                return
+            self.cancel_speculation()
+        pass_ = self.speculation_pass
+        test_case = self.sorted_test_cases[0]
+        if not self.no_cache and self.cache.contains(repr(pass_), hash_file(test_case)):
+            return
+        folder = self.acquire_folder()
+        # a reused folder may hold the files of another variant
+        stage_files(folder, test_case, [])
+        path = os.path.join(folder, os.path.basename(test_case))
+        self.speculation = Speculation(pass_, test_case, key, folder)
+        self.speculation.future = self.scheduler.schedule(
+            speculate_new, args=(pass_, path), timeout=self.get_timeout(),
+            continuation=functools.partial(self.schedule_speculative_variants, self.speculation))
+
+    # Continuation of speculate_new, the variants run when test workers become idle
+    def schedule_speculative_variants(self, speculation, result):
+        speculation.result = result
+        if result is None or result[1] is None or self.no_cache or speculation.key != self.get_snapshot_key():
+            return None
+        pass_, state, data = result
+        test_case = speculation.test_case
+        name = os.path.basename(test_case)
+        others = self.test_cases ^ {test_case}
+        # the variants may outlive the pass and its root
+        self.snapshot_count += 1
+        speculation.snapshot = os.path.join(self.run_root, f'snapshot-{self.snapshot_count}.pickle')
+        write_snapshot(speculation.snapshot, pass_, state, (hash_context(test_case, others), {}))
+        for _ in range(self.parallel_tests):
+            folder = self.acquire_folder()
+            stage_files(folder, test_case, others)
+            with open(os.path.join(folder, name), 'wb') as f:
+                f.write(data)
+            future = self.scheduler.schedule(run_variant,
+                                             args=(speculation.snapshot, (False, state), folder, name, self.test_script),
+                                             timeout=self.get_timeout())
+            speculation.variants[future] = folder
+            state = pass_.advance(os.path.join(speculation.folder, name), state)
+            if state is None:
+                break
+        return None
+
+    def cancel_speculation(self):
+        if self.speculation:
+            self.release_speculation(self.speculation)
+            self.speculation = None
+
+    # Cancel the unfinished jobs of the speculation and release its folders
+    def release_speculation(self, speculation):
+        if speculation.folder:
+            speculation.future.cancel()
+            self.release_test_folder(speculation.folder, speculation.future)
+            speculation.folder = None
+        for future, folder in speculation.variants.items():
+            future.cancel()
+            self.release_test_folder(folder, future)
+        speculation.variants = {}
+        if speculation.snapshot:
+            os.unlink(speculation.snapshot)
+            speculation.snapshot = None
+
+    # Hand the speculation over to the next pass, without waiting for its jobs. It is
+    # dropped if the test cases changed meanwhile.
+    def finish_speculation(self):
+        if self.speculated:
+            self.release_speculation(self.speculated)
+        self.speculated = self.speculation
+        self.speculation = None
+        self.collect_speculation()
+
+    # Add the results of the finished variants of the handed over speculation to the
+    # result cache. Once the test cases change, the variants are of no use anymore.
+    def collect_speculation(self):
+        speculated = self.speculated
+        if speculated is None:
+            return
+        if speculated.key != self.get_snapshot_key():
+            self.release_speculation(speculated)
+            self.speculated = None
+            return
+        if speculated.folder and speculated.future.done():
+            self.release_test_folder(speculated.folder, speculated.future)
+            speculated.folder = None
+        for future in [future for future in speculated.variants if future.done()]:
+            if not future.cancelled() and future.exception() is None:
+                (_, returncode, _, digest, test_seconds) = future.result()
+                if digest is not None and test_seconds is not None:
+                    self.test_cache.add(digest, returncode, test_seconds)
+                    self.new_results.append(digest)
+            self.release_test_folder(speculated.variants.pop(future), future)
+
+    # Return the speculated initial state of the pass for the test case, or None
+    def take_speculated(self, test_case):
+        self.collect_speculation()
+        speculated = self.speculated
+        if (speculated is None or repr(speculated.pass_) != repr(self.current_pass) or speculated.test_case != test_case
+                or speculated.future.cancelled()):
+            return None
+        # the initial state is still cheaper to wait for than to create again
+        self.scheduler.wait([speculated.future])
+        if speculated.future.exception() is not None or speculated.result is None:
+            return None
+        with open(test_case, 'rb') as f:
+            # a pass that changes the test case in new (e.g. formatting) must check it
+            if f.read() != speculated.result[2]:
+                return None
+        # new may set attributes of the pass
+        self.current_pass.__dict__.update(speculated.result[0].__dict__)
+        logging.debug(f'using the speculated initial state of {self.current_pass}')
+        return speculated
 
     def run_parallel_tests(self):
         assert not self.futures
         assert not self.temporary_folders
-        with pebble.ProcessPool(max_workers=self.parallel_tests) as pool:
-            order = 1
-            self.timeout_count = 0
-            while self.state is not None:
-                # do not create too many states
-                if len(self.futures) >= self.parallel_tests:
-                    wait(self.futures, return_when=FIRST_COMPLETED)
-
-                quit_loop = self.process_done_futures()
-                if quit_loop:
-                    success = self.wait_for_first_success()
-                    self.terminate_all(pool)
-                    return success
-
-                folder = tempfile.mkdtemp(prefix=self.TEMP_PREFIX, dir=self.root)
-                test_env = TestEnvironment(self.state, order, self.test_script, folder,
-                                           self.current_test_case, self.test_cases ^ {self.current_test_case},
-                                           self.current_pass.transform, self.pid_queue)
-                future = pool.schedule(test_env.run, timeout=self.timeout)
-                self.temporary_folders[future] = folder
-                self.futures.append(future)
-                self.pass_statistic.add_executed(self.current_pass)
-                order += 1
-                state = self.current_pass.advance(self.current_test_case, self.state)
-                # we are at the end of enumeration
-                if state is None:
-                    success = self.wait_for_first_success()
-                    self.terminate_all(pool)
-                    return success
+        order = 1
+        self.timeout_count = 0
+        self.base_state = self.state
+        # workers cache the snapshot by its path, so every batch gets a new file
+        if self.snapshot:
+            os.unlink(self.snapshot)
+        self.snapshot_count += 1
+        self.snapshot = os.path.join(self.root, f'snapshot-{self.snapshot_count}.pickle')
+        write_snapshot(self.snapshot, self.current_pass, self.base_state, self.get_cache_context(self.current_test_case))
+        while self.state is not None:
+            if self.parallelism:
+                self.tune_parallelism()
+            # do not create too many states; transformers keep a bounded queue of variants ahead of the tests
+            if len(self.futures) >= self.parallel_tests + self.transformers:
+                self.scheduler.wait(self.futures, return_when_all=False)
+
+            quit_loop = self.process_done_futures()
+            if quit_loop:
+                success = self.wait_for_first_success()
+                self.terminate_all()
+                return self.merge_successes(success) if success else None
+
+            folder = self.acquire_folder()
+            test_env = TestEnvironment(self.state, order, self.test_script, folder,
+                                       self.current_test_case, self.test_cases ^ {self.current_test_case})
+            future = self.schedule_variant(folder, test_env.test_case, self.snapshot, self.base_state, self.state)
+            self.temporary_folders[future] = folder
+            self.environments[future] = test_env
+            self.futures.append(future)
+            self.pass_statistic.add_executed(self.current_pass)
+            order += 1
+            state = self.current_pass.advance(self.current_test_case, self.state)
+            # we are at the end of enumeration
+            if state is None:
+                if self.speculation_pass:
+                    self.start_speculation()
+                success = self.wait_for_first_success()
+                self.terminate_all()
+                if success:
+                    self.cancel_speculation()
+                return self.merge_successes(success) if success else None
+            else:
+                self.state = state
+
+    # Apply the cached result of the pass to test_case. Return the digest of test_case,
+    # or None on a cache hit.
+    def apply_pass_cache(self, pass_key, test_case):
+        with open(test_case, mode='rb') as tmp_file:
+            test_case_before_pass = tmp_file.read()
+        digest = hash_data(test_case_before_pass)
+        cached = self.cache.get(pass_key, digest, test_case_before_pass)
+        if cached is None:
+            return digest
+        if cached is not test_case_before_pass:
+            replace_file(test_case, cached)
+            self.update_file_statistics(test_case, test_case_before_pass, cached)
+        logging.info(f'cache hit for {test_case}')
+        return None
+
+    def check_key_press(self, logger):
+        # Ignore more key presses after skip has been detected
+        if not self.skip_key_off and not self.skip:
+            key = logger.pressed_key()
+            if key == 's':
+                self.skip = True
+                self.log_key_event('skipping the rest of this pass')
+            elif key == 'd':
+                self.log_key_event('toggle print diff')
+                self.print_diff = not self.print_diff
+
+    # Return the initial state of pass_ for test_case. Some passes rewrite the test case
+    # in new (e.g. the formatting of the lines pass), the statistics follow the change.
+    def create_state(self, pass_, test_case):
+        with open(test_case, 'rb') as f:
+            before = f.read()
+        state = pass_.new(test_case, self.check_sanity)
+        with open(test_case, 'rb') as f:
+            if f.read() != before:
+                self.versions[test_case] += 1
+                self.update_statistics([test_case])
+        return state
+
+    def start_lane(self, test_case, pass_key):
+        lane = FileLane(copy.deepcopy(self.current_pass), test_case)
+        lane.starting_size = self.file_sizes[test_case]
+        if lane.starting_size == 0:
+            return None
+        if not self.no_cache:
+            lane.digest_before_pass = self.apply_pass_cache(pass_key, test_case)
+            if lane.digest_before_pass is None:
+                return None
+        speculated = self.take_speculated(test_case)
+        if speculated:
+            lane.pass_.__dict__.update(speculated.result[0].__dict__)
+            lane.state = speculated.result[1]
+        else:
+            lane.state = self.create_state(lane.pass_, test_case)
+        return lane
+
+    def schedule_lane_variant(self, lane):
+        # the snapshot carries the hash of the other test cases for the result cache
+        if lane.versions != self.versions:
+            if lane.snapshot and not lane.futures:
+                os.unlink(lane.snapshot)
+            lane.base_state = lane.state
+            lane.versions = dict(self.versions)
+            self.snapshot_count += 1
+            lane.snapshot = os.path.join(self.root, f'snapshot-{self.snapshot_count}.pickle')
+            write_snapshot(lane.snapshot, lane.pass_, lane.base_state, self.get_cache_context(lane.test_case))
+
+        folder = self.acquire_folder()
+        test_env = TestEnvironment(lane.state, lane.order, self.test_script, folder,
+                                   lane.test_case, self.test_cases ^ {lane.test_case})
+        test_env.base_state = lane.base_state
+        test_env.versions = lane.versions
+        future = self.schedule_variant(folder, test_env.test_case, lane.snapshot, lane.base_state, lane.state)
+        self.temporary_folders[future] = folder
+        self.environments[future] = test_env
+        lane.futures.append(future)
+        self.pass_statistic.add_executed(self.current_pass)
+        lane.order += 1
+        lane.state = lane.pass_.advance(lane.test_case, lane.state)
+
+    def is_current(self, test_env, test_case):
+        return all(self.versions[f] == test_env.versions[f] for f in self.test_cases ^ {test_case})
+
+    # Test a successful variant again with the current versions of the other test
+    # cases, the future takes the place of the variant in the lane
+    def schedule_retest(self, test_env, test_case):
+        folder = self.acquire_folder()
+        retest_env = TestEnvironment(test_env.state, test_env.order, self.test_script, folder, test_case,
+                                     self.test_cases ^ {test_case})
+        shutil.copy(test_env.test_case_path, retest_env.test_case_path)
+        retest_env.versions = dict(self.versions)
+        retest_env.retest = True
+        future = self.scheduler.schedule(run_merged_variant,
+                                         args=(folder, self.test_script, self.get_remote(retest_env.test_case)),
+                                         timeout=self.get_timeout())
+        self.temporary_folders[future] = folder
+        self.environments[future] = retest_env
+        self.pass_statistic.add_executed(self.current_pass)
+        return future
+
+    def cancel_lane(self, lane):
+        for future in lane.futures:
+            future.cancel()
+            self.release_folder(future)
+        lane.futures = []
+
+    # Commit the successes of the lane and record the other outcomes, in the order of
+    # the variants
+    def process_lane(self, lane):
+        while lane.futures and lane.futures[0].done():
+            future = lane.futures.pop(0)
+            test_env = self.environments[future]
+            if future.exception():
+                if type(future.exception()) is not TimeoutError:
+                    raise future.exception()
+                lane.timeout_count += 1
+                self.record_timeout(future)
+                if lane.timeout_count >= self.MAX_TIMEOUTS:
+                    logging.warning('Maximum number of timeout were reached: %d' % self.MAX_TIMEOUTS)
+                    lane.stopped = True
+                self.release_folder(future)
+                continue
+
+            if test_env.retest:
+                test_env.exitcode = future.result()
+                test_env.result = PassResult.OK
+                success, stop = (test_env.success, False)
+                if not success:
+                    logging.debug(f'a variant of {lane.test_case} is not interesting with the current versions '
+                                  'of the other test cases')
+            else:
+                test_env.set_outcome(future.result(), test_env.base_state)
+                self.add_test_result(test_env)
+                self.add_runtime(test_env)
+                success, stop = self.check_outcome(test_env, lane.test_case)
+            if success and not self.is_current(test_env, lane.test_case):
+                # the other lanes go on while the variant is tested again
+                lane.futures.insert(0, self.schedule_retest(test_env, lane.test_case))
+                self.release_folder(future)
+                continue
+            if success:
+                self.commit_variant(lane.test_case, test_env)
+                lane.state = lane.pass_.advance_on_success(test_env.test_case_path, test_env.state)
+                lane.success_count += 1
+                lane.timeout_count = 0
+                # the other variants of the lane are based on the previous version
+                self.cancel_lane(lane)
+                if self.file_sizes[lane.test_case] >= MAX_PASS_INCREASEMENT_THRESHOLD * lane.starting_size:
+                    logging.info(f'skipping the rest of the pass for {lane.test_case} (huge file increasement '
+                                 f'{MAX_PASS_INCREASEMENT_THRESHOLD * 100}%)')
+                    lane.stopped = True
+                if ((self.skip_after_n_transforms and lane.success_count >= self.skip_after_n_transforms)
+                        or (lane.pass_.max_transforms and lane.success_count >= lane.pass_.max_transforms)):
+                    logging.info(f'skipping after {lane.success_count} successful transformations of {lane.test_case}')
+                    lane.stopped = True
+            elif stop and not success:
+                lane.stopped = True
+            self.release_folder(future)
+
+    # Reduce up to parallel_files test cases at the same time. The lanes share the test
+    # workers; the variants of a test case are staged with the current versions of the
+    # others. Successes are committed one at a time by this process, one that was tested
+    # with an older version of another test case is tested again before.
+    def run_lanes(self, test_cases, pass_key, logger):
+        pending = list(test_cases)
+        lanes = []
+        while lanes or pending:
+            while pending and len(lanes) < self.parallel_files:
+                lane = self.start_lane(pending.pop(0), pass_key)
+                if lane:
+                    lanes.append(lane)
+
+            self.save_checkpoint(None)
+            if self.exchange and self.is_outdated():
+                logging.info('skipping the rest of the pass, the portfolio has a smaller snapshot')
+                for lane in lanes:
+                    self.cancel_lane(lane)
+                self.scheduler.drain()
+                return
+            if self.parallelism:
+                self.tune_parallelism()
+            self.check_key_press(logger)
+            if self.skip:
+                pending = []
+                for lane in lanes:
+                    lane.stopped = True
+
+            # the lanes take turns until the test workers are busy
+            in_flight = sum(len(lane.futures) for lane in lanes)
+            active = [lane for lane in lanes if lane.state is not None and not lane.stopped]
+            while active and in_flight < self.parallel_tests + self.transformers:
+                for lane in active:
+                    if in_flight < self.parallel_tests + self.transformers:
+                        self.schedule_lane_variant(lane)
+                        in_flight += 1
+                active = [lane for lane in active if lane.state is not None]
+            if self.speculation_pass and not pending and not active:
+                self.start_speculation()
+
+            # the outcomes of a lane are processed in order
+            futures = [lane.futures[0] for lane in lanes if lane.futures]
+            if futures:
+                self.scheduler.wait(futures, return_when_all=False)
+            for lane in lanes:
+                self.process_lane(lane)
+
+            for lane in [lane for lane in lanes if (lane.state is None or lane.stopped) and not lane.futures]:
+                lanes.remove(lane)
+                if lane.snapshot:
+                    os.unlink(lane.snapshot)
+                if not self.no_cache:
+                    with open(lane.test_case, mode='rb') as tmp_file:
+                        self.cache.add(pass_key, lane.digest_before_pass, tmp_file.read())
+
+    # Reduce the test cases one after another
+    def run_files(self, test_cases, progress, pass_key, next_pass, logger):
+        for index, test_case in enumerate(test_cases):
+            if progress and index < progress.index:
+                continue
+            self.current_test_case = test_case
+            starting_test_case_size = self.file_sizes[test_case]
+            success_count = 0
+            digest_before_pass = None
+            outdated = False
+            # the next pass is started ahead while the last test case finishes
+            self.speculation_pass = next_pass if self.speculate and index == len(test_cases) - 1 else None
+
+            if starting_test_case_size == 0:
+                continue
+
+            if progress and index == progress.index:
+                starting_test_case_size = progress.starting_size
+                success_count = progress.success_count
+                digest_before_pass = progress.digest_before_pass
+                self.state = progress.state
+                logging.info(f'resuming {self.current_pass} for {test_case}')
+            else:
+                if not self.no_cache:
+                    digest_before_pass = self.apply_pass_cache(pass_key, test_case)
+                    if digest_before_pass is None:
+                        continue
+
+                # create initial state
+                speculated = self.take_speculated(test_case) if index == 0 else None
+                if speculated:
+                    self.state = speculated.result[1]
                 else:
-                    self.state = state
+                    self.state = self.create_state(self.current_pass, self.current_test_case)
+            self.skip = False
+
+            while self.state is not None and not self.skip:
+                self.save_checkpoint(PassProgress(self.current_pass, test_cases, index, starting_test_case_size,
+                                                  success_count, digest_before_pass, self.state))
+                if self.exchange and self.is_outdated():
+                    logging.info('skipping the rest of the pass, the portfolio has a smaller snapshot')
+                    outdated = True
+                    break
+
+                self.check_key_press(logger)
+                success_env = self.run_parallel_tests()
+
+                if success_env:
+                    self.process_result(success_env)
+                    success_count += 1
+
+                # if the file increases significantly, bail out the current pass
+                test_case_size = self.file_sizes[self.current_test_case]
+                if test_case_size >= MAX_PASS_INCREASEMENT_THRESHOLD * starting_test_case_size:
+                    logging.info(f'skipping the rest of the pass (huge file increasement '
+                                 f'{MAX_PASS_INCREASEMENT_THRESHOLD * 100}%)')
+                    break
+
+                self.release_folders()
+                self.futures.clear()
+                if not success_env:
+                    break
+
+                # skip after N transformations if requested
+                if ((self.skip_after_n_transforms and success_count >= self.skip_after_n_transforms)
+                        or (self.current_pass.max_transforms and success_count >= self.current_pass.max_transforms)):
+                    logging.info(f'skipping after {success_count} successful transformations')
+                    break
+
+            # the snapshot is adopted before the next pass
+            if outdated:
+                break
+
+            # Cache result of this pass
+            if not self.no_cache:
+                with open(test_case, mode='rb') as tmp_file:
+                    self.cache.add(pass_key, digest_before_pass, tmp_file.read())
 
-    def run_pass(self, pass_):
+    def run_pass(self, pass_, next_pass=None):
         if self.start_with_pass:
             if self.start_with_pass == str(pass_):
                 self.start_with_pass = None
             else:
                 return
 
+        if self.exchange:
+            self.exchange_snapshots()
+
+        # the pass of a resumed run continues with the saved progress
+        progress = self.resume_progress
+        self.resume_progress = None
+        if progress and repr(progress.pass_) == repr(pass_):
+            pass_ = progress.pass_
+        else:
+            progress = None
+
         self.current_pass = pass_
         self.futures = []
         self.temporary_folders = {}
-        m = Manager()
-        self.pid_queue = m.Queue()
+        self.environments = {}
         self.create_root()
+        self.snapshot = None
+        # the snapshots send the results since the start of the workers to them; new
+        # workers get all results at once
+        if self.scheduler and len(self.new_results) > self.MAX_NEW_RESULTS:
+            self.stop_workers()
+        if self.scheduler is None:
+            self.start_workers()
         pass_key = repr(self.current_pass)
 
         logging.info(f'===< {self.current_pass} >===')
@@ -486,100 +1264,55 @@ class TestManager:
         if self.total_file_size == 0:
             raise ZeroSizeError(self.test_cases)
 
-        self.pass_statistic.start(self.current_pass)
-        if not self.skip_key_off:
-            logger = KeyLogger()
+        self.pass_statistic.start(self.current_pass, self.scheduler.get_pids())
+        starting_size = self.total_file_size
+        logger = None if self.skip_key_off else KeyLogger()
 
         try:
-            for test_case in self.sorted_test_cases:
-                self.current_test_case = test_case
-                starting_test_case_size = os.path.getsize(test_case)
-                success_count = 0
-
-                if self.get_file_size([test_case]) == 0:
-                    continue
-
-                if not self.no_cache:
-                    with open(test_case, mode='rb+') as tmp_file:
-                        test_case_before_pass = tmp_file.read()
-
-                        if (pass_key in self.cache and
-                                test_case_before_pass in self.cache[pass_key]):
-                            tmp_file.seek(0)
-                            tmp_file.truncate(0)
-                            tmp_file.write(self.cache[pass_key][test_case_before_pass])
-                            logging.info(f'cache hit for {test_case}')
-                            continue
-
-                # create initial state
-                self.state = self.current_pass.new(self.current_test_case, self.check_sanity)
+            test_cases = progress.test_cases if progress else self.sorted_test_cases
+            if self.parallel_files > 1 and len(test_cases) > 1 and not progress:
+                # a resumed pass continues one test case at a time
+                self.speculation_pass = next_pass if self.speculate else None
                 self.skip = False
-
-                while self.state is not None and not self.skip:
-                    # Ignore more key presses after skip has been detected
-                    if not self.skip_key_off and not self.skip:
-                        key = logger.pressed_key()
-                        if key == 's':
-                            self.skip = True
-                            self.log_key_event('skipping the rest of this pass')
-                        elif key == 'd':
-                            self.log_key_event('toggle print diff')
-                            self.print_diff = not self.print_diff
-
-                    success_env = self.run_parallel_tests()
-                    self.kill_pid_queue()
-
-                    if success_env:
-                        self.process_result(success_env)
-                        success_count += 1
-
-                    # if the file increases significantly, bail out the current pass
-                    test_case_size = os.path.getsize(self.current_test_case)
-                    if test_case_size >= MAX_PASS_INCREASEMENT_THRESHOLD * starting_test_case_size:
-                        logging.info(f'skipping the rest of the pass (huge file increasement '
-                                     f'{MAX_PASS_INCREASEMENT_THRESHOLD * 100}%)')
-                        break
-
-                    self.release_folders()
-                    self.futures.clear()
-                    if not success_env:
-                        break
-
-                    # skip after N transformations if requested
-                    if ((self.skip_after_n_transforms and success_count >= self.skip_after_n_transforms)
-                            or (self.current_pass.max_transforms and success_count >= self.current_pass.max_transforms)):
-                        logging.info(f'skipping after {success_count} successful transformations')
-                        break
-
-                # Cache result of this pass
-                if not self.no_cache:
-                    with open(test_case, mode='rb') as tmp_file:
-                        if pass_key not in self.cache:
-                            self.cache[pass_key] = {}
-
-                        self.cache[pass_key][test_case_before_pass] = tmp_file.read()
-
+                self.run_lanes(test_cases, pass_key, logger)
+            else:
+                self.run_files(test_cases, progress, pass_key, next_pass, logger)
             self.restore_mode()
-            self.pass_statistic.stop(self.current_pass)
+            self.finish_speculation()
+            self.new_results += self.test_cache.sync()
+            self.pass_statistic.stop(self.current_pass, starting_size - self.total_file_size, self.scheduler.get_pids())
             self.remove_root()
         except KeyboardInterrupt:
             logging.info('Exiting now ...')
             self.remove_root()
             sys.exit(1)
+        except BaseException:
+            # the workers are kept for the next pass only after a complete pass
+            self.stop_workers()
+            raise
 
     def process_result(self, test_env):
+        self.commit_variant(self.current_test_case, test_env)
+        self.state = self.current_pass.advance_on_success(test_env.test_case_path, test_env.state)
+
+    # Replace test_case by a successful variant. The test case gets a new file, so that
+    # a test that still reads the old one never sees a partly written file.
+    def commit_variant(self, test_case, test_env):
         if self.print_diff:
-            diff_str = self.diff_files(self.current_test_case, test_env.test_case_path)
+            diff_str = self.diff_files(test_case, test_env.test_case_path)
             if self.use_colordiff:
                 diff_str = subprocess.check_output('colordiff', shell=True, encoding='utf8', input=diff_str)
             logging.info(diff_str)
 
         try:
-            shutil.copy(test_env.test_case_path, self.current_test_case)
+            with open(test_env.test_case_path, 'rb') as f:
+                new = f.read()
+            with open(test_case, 'rb') as f:
+                old = f.read()
+            replace_file(test_case, new)
         except FileNotFoundError:
-            raise RuntimeError(f"Can't find {self.current_test_case} -- did your interestingness test move it?")
-
-        self.state = self.current_pass.advance_on_success(test_env.test_case_path, test_env.state)
+            raise RuntimeError(f"Can't find {test_case} -- did your interestingness test move it?")
+        self.update_file_statistics(test_case, old, new)
         self.pass_statistic.add_success(self.current_pass)
 
         pct = 100 - (self.total_file_size * 100.0 / self.orig_total_file_size)
@@ -0,0 +1,85 @@
+import os
+import shlex
+import subprocess
+
+from cvise.utils.error import InterestingnessServerError
+from cvise.utils.process import kill_process_group
+from cvise.utils.scheduler import is_cancelled, JobCancelledError, process_start_guard
+
+# With --test-server, the interestingness test is started once per test worker, with
+# CVISE_TEST_SERVER=1 in its environment, and serves all variants of the worker: it
+# reads the path of a variant folder per line from stdin and writes the exit code for
+# the variant as a line to stdout (other output must go to stderr). A test that exits
+# or breaks the protocol is started again and gets the same variant once more; if it
+# fails again, the variant is not tested. Cancelling a variant kills the server that
+# tests it, which is started again for the next variant.
+#
+#   #!/bin/bash
+#   # warm up here
+#   while read -r folder; do
+#     (cd "$folder" && gcc -c t.c 2>&1 | grep -q 'internal compiler error'); echo $?
+#   done
+
+ENVIRONMENT_VARIABLE = 'CVISE_TEST_SERVER'
+
+
+# The server is in process_groups while it runs and in request_groups (the process
+# groups of the current job) while it tests a variant
+class InterestingnessServer:
+    def __init__(self, test_script, process_groups=None, request_groups=None):
+        self.test_script = test_script
+        self.process_groups = process_groups
+        self.request_groups = request_groups
+        self.proc = None
+
+    def start(self):
+        env = dict(os.environ, **{ENVIRONMENT_VARIABLE: '1'})
+        with process_start_guard():
+            self.proc = subprocess.Popen(shlex.quote(self.test_script), shell=True, stdin=subprocess.PIPE,
+                                         stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, env=env,
+                                         universal_newlines=True, start_new_session=True)
+        if self.process_groups:
+            self.process_groups.add(self.proc.pid)
+
+    def stop(self):
+        if self.proc is None:
+            return
+        kill_process_group(self.proc.pid)
+        self.proc.wait()
+        self.proc.stdout.close()
+        try:
+            self.proc.stdin.close()
+        except BrokenPipeError:
+            # a write the test did not read is still buffered
+            pass
+        if self.process_groups:
+            self.process_groups.remove(self.proc.pid)
+        self.proc = None
+
+    def send(self, folder):
+        if self.proc is None:
+            self.start()
+        if self.request_groups:
+            self.request_groups.add(self.proc.pid)
+        try:
+            # a cancellation that arrived before the server was added did not kill it
+            if is_cancelled():
+                raise JobCancelledError()
+            self.proc.stdin.write(os.path.abspath(folder) + '\n')
+            self.proc.stdin.flush()
+            return self.proc.stdout.readline()
+        except BrokenPipeError:
+            return ''
+        finally:
+            if self.request_groups:
+                self.request_groups.remove(self.proc.pid)
+
+    # Return the exit code of the test for the variant in folder
+    def run(self, folder):
+        for _ in range(2):
+            try:
+                return int(self.send(folder))
+            except ValueError:
+                # the test exited or broke the protocol
+                self.stop()
+        raise InterestingnessServerError(self.test_script)
@@ -0,0 +1,193 @@
+import copy
+import os
+import pickle
+import time
+import traceback
+
+from cvise.passes.abstract import PassResult, ProcessEventNotifier
+from cvise.utils.cache import hash_variant
+from cvise.utils.error import InterestingnessServerError, RemoteWorkerError
+from cvise.utils.remote import run_remote_test
+from cvise.utils.scheduler import get_process_groups, get_server_groups, JobCancelledError, process_start_guard
+from cvise.utils.testserver import InterestingnessServer
+
+# Test workers live for a whole pass. The pass object and the state all variants of
+# a batch are derived from are pickled once into a snapshot file; a scheduled variant
+# only carries the state attributes that differ from the snapshot.
+# Workers get the known test results when they start; a snapshot adds the hash of
+# the files that are not transformed and the results that were found since then.
+
+_snapshot = (None, None, None)
+_cache_context = None
+_known_results = {}
+# with test_server, the interestingness test of the worker serves all its variants
+_use_test_server = False
+_test_server = None
+
+
+def init_worker(known_results=None, test_server=False):
+    global _known_results, _use_test_server
+    _known_results = dict(known_results or {})
+    _use_test_server = test_server
+
+
+def get_test_server(test_script):
+    global _test_server
+    if _test_server is None or _test_server.test_script != test_script:
+        if _test_server:
+            _test_server.stop()
+        _test_server = InterestingnessServer(test_script, get_server_groups(), get_process_groups())
+    return _test_server
+
+
+def write_snapshot(path, pass_, state, cache_context=None):
+    with open(path, 'wb') as f:
+        pickle.dump((pass_, state, cache_context), f, protocol=pickle.HIGHEST_PROTOCOL)
+
+
+def load_snapshot(path):
+    global _snapshot, _cache_context
+    if _snapshot[0] != path:
+        with open(path, 'rb') as f:
+            pass_, state, cache_context = pickle.load(f)
+        _snapshot = (path, pass_, state)
+        _cache_context = None
+        if cache_context:
+            _cache_context, new_results = cache_context
+            _known_results.update(new_results)
+    return _snapshot[1:]
+
+
+def get_state_items(state):
+    if isinstance(state, dict):
+        return state
+    return getattr(state, '__dict__', None)
+
+
+# Return the attributes of state that are not shared with base. Advancing a state
+# makes a shallow copy, so large members (e.g. lists of modifications) stay shared.
+def state_delta(base, state):
+    base_items = get_state_items(base)
+    items = get_state_items(state)
+    if (base_items is None or items is None or type(base) is not type(state)
+            or base_items.keys() != items.keys()):
+        return (False, state)
+    return (True, {k: v for k, v in items.items() if base_items[k] is not v})
+
+
+def apply_delta(base, delta):
+    partial, value = delta
+    if not partial:
+        return value
+    state = copy.copy(base)
+    get_state_items(state).update(value)
+    return state
+
+
+# Processes of a cancelled variant are killed by the scheduler, this makes sure
+# that no new one is started
+class WorkerProcessEventNotifier(ProcessEventNotifier):
+    def __init__(self):
+        super().__init__(get_process_groups())
+
+    def start_process(self, cmd, stdout, stderr, shell):
+        with process_start_guard():
+            return super().start_process(cmd, stdout, stderr, shell)
+
+
+def run_test(test_script, folder, process_event_notifier):
+    pwd = os.getcwd()
+    try:
+        os.chdir(folder)
+        return process_event_notifier.run_process(test_script, shell=True)
+    finally:
+        os.chdir(pwd)
+
+
+# Run the interestingness test on the files in folder; remote is the address of
+# a worker daemon and the name of the transformed test case
+def get_returncode(folder, test_script, remote):
+    if remote:
+        return run_remote_test(remote[0], folder, remote[1], test_script)
+    if _use_test_server:
+        return get_test_server(test_script).run(folder)
+    _, _, returncode = run_test(test_script, folder, WorkerProcessEventNotifier())
+    return returncode
+
+
+# Run the interestingness test on a variant that is already in folder
+def run_merged_variant(folder, test_script, remote=None):
+    try:
+        return get_returncode(folder, test_script, remote)
+    except InterestingnessServerError:
+        return None
+
+
+# Transform the variant in folder. The outcome is (result, exit code, state delta,
+# content digest, test seconds); the exit code is only known here for a variant
+# that was tested before.
+def transform_variant(snapshot, delta, folder, test_case):
+    pass_, base = load_snapshot(snapshot)
+    state = apply_delta(base, delta)
+    try:
+        path = os.path.join(folder, test_case)
+        (result, state) = pass_.transform(path, state, WorkerProcessEventNotifier())
+        digest = None
+        if result == PassResult.OK and _cache_context is not None:
+            digest = hash_variant(_cache_context, path)
+        return (result, _known_results.get(digest), state_delta(base, state), digest, None)
+    except (OSError, JobCancelledError):
+        # this can happen for cancelled variants, whose temporary files are cleaned up
+        return (None, None, delta, None, None)
+    except Exception as e:
+        print('Unexpected transform_variant failure: ' + str(e))
+        traceback.print_exc()
+        return (None, None, delta, None, None)
+
+
+def is_tested(outcome):
+    return outcome[0] != PassResult.OK or outcome[1] is not None
+
+
+# Run the interestingness test on a variant transformed by transform_variant
+def test_variant(folder, test_script, outcome, remote=None):
+    (result, _, delta, digest, _) = outcome
+    try:
+        start = time.monotonic()
+        returncode = get_returncode(folder, test_script, remote)
+        if digest is not None:
+            _known_results[digest] = returncode
+        return (result, returncode, delta, digest, time.monotonic() - start)
+    except RemoteWorkerError:
+        raise
+    except (OSError, JobCancelledError, InterestingnessServerError):
+        # the variant was not tested, its outcome is not cached
+        return (None, None, delta, None, None)
+    except Exception as e:
+        print('Unexpected test_variant failure: ' + str(e))
+        traceback.print_exc()
+        return (None, None, delta, None, None)
+
+
+# Create the initial state of a pass on a copy of a test case, ahead of the pass.
+# The pass is sent back as well, as passes keep some state.
+def speculate_new(pass_, path):
+    try:
+        state = pass_.new(path, None)
+        with open(path, 'rb') as f:
+            return (pass_, state, f.read())
+    except (OSError, JobCancelledError):
+        return None
+    except Exception as e:
+        print('Unexpected speculate_new failure: ' + str(e))
+        traceback.print_exc()
+        return None
+
+
+# Transform the variant in folder and run the interestingness test on it.
+# Only the outcome is sent back.
+def run_variant(snapshot, delta, folder, test_case, test_script):
+    outcome = transform_variant(snapshot, delta, folder, test_case)
+    if is_tested(outcome):
+        return outcome
+    return test_variant(folder, test_script, outcome)